@@ -0,0 +1,215 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include "Server.hpp"
+#include "InputBuffer.hpp"
+
+/*
+Hot path benchmark: the parser, the line framing, the reply
+formatting and the channel fan-outs, timed one operation at a time
+with the heap allocations each one makes. The server runs the real
+handlers on a reactor without sockets, whose flush drops the
+queued replies: the null sink.
+*/
+
+# define ITERATIONS 20000
+# define MEMBERS 100
+# define FD_BASE 1000
+
+bool	g_end;
+
+/* Reactor whose sockets are a null sink */
+class NullReactor : public Reactor {
+
+public:
+	virtual void	start(int) {}
+	virtual int		poll() { return (0); }
+	virtual int		addConnection(User &) { return (0); }
+	virtual void	removeConnection(User &) {}
+
+	virtual int		flush(User &user)
+	{
+		std::deque<SharedBuffer> const	&chunks = user.getSendQueue().getChunks();
+		size_t							bytes = 0;
+
+		for (size_t i = 0; i < chunks.size(); ++i)
+			bytes += chunks[i].length();
+		user.consumeOutput(bytes - user.getSendQueue().getOffset());
+		return (0);
+	}
+};
+
+struct Bench {
+	Server					*server;
+	User					*user;
+	Channel					*channel;
+	std::vector<std::string>	lines;
+	std::string				burst;
+	InputBuffer				input;
+	size_t					next;
+	size_t					sink;
+};
+
+typedef void	(*Operation)(Bench &bench);
+
+/* Runs a command line of a user and drops its replies */
+static void	exec(Bench &bench, User &user, std::string const &line)
+{
+	bench.server->execCommand(user, line.data(), line.length());
+	bench.server->flushPendingWrites();
+}
+
+/******************************************************************************/
+/*									OPERATIONS								  */
+/******************************************************************************/
+
+static void	parseLine(Bench &bench)
+{
+	std::string const	&line = bench.lines[bench.next++ % bench.lines.size()];
+	Message				message;
+
+	parseMessage(line.data(), line.length(), message);
+	bench.sink += message.paramCount;
+}
+
+static void	frameBurst(Bench &bench)
+{
+	const char	*line;
+	size_t		length;
+
+	bench.input.append(bench.burst.data(), bench.burst.length());
+	while (bench.input.nextLine(line, length))
+		bench.sink += length;
+	bench.input.compact();
+}
+
+static void	formatReply(Bench &bench)
+{
+	bench.sink += Reply(RPL_WHOREPLY).arg("alice").arg("#bench").arg("member42")
+		.arg(":member42!~member42@127.0.0.1").arg("member42").arg("@").buffer().length();
+}
+
+static void	formatMacro(Bench &bench)
+{
+	std::string const	sender = ":member42!~member42@127.0.0.1";
+	std::string const	target = "#bench";
+	std::string const	text = ":hello everyone, how is it going?";
+	std::string			mess;
+
+	mess = CMD_NOTICE_TARGET(sender, text, target);
+	bench.sink += SharedBuffer(mess).length();
+}
+
+static void	privmsgChannel(Bench &bench)
+{
+	static std::string const	line = "PRIVMSG #bench :hello everyone, how is it going?";
+
+	exec(bench, *bench.user, line);
+}
+
+static void	namesCached(Bench &bench)
+{
+	bench.channel->names(*bench.server, *bench.user);
+	bench.server->flushPendingWrites();
+}
+
+static void	namesRebuilt(Bench &bench)
+{
+	bench.channel->invalidateNames();
+	bench.channel->names(*bench.server, *bench.user);
+	bench.server->flushPendingWrites();
+}
+
+static void	whoChannel(Bench &bench)
+{
+	bench.channel->who(*bench.server, *bench.user, false);
+	bench.server->flushPendingWrites();
+}
+
+/******************************************************************************/
+/*									RUNNER									  */
+/******************************************************************************/
+
+static void	measure(Bench &bench, const char *name, Operation operation, size_t iterations)
+{
+	unsigned long	allocations;
+	unsigned long	start;
+	double			ns;
+
+	operation(bench);
+	allocations = threadAllocations();
+	start = monotonicNanoseconds();
+	for (size_t i = 0; i < iterations; ++i)
+		operation(bench);
+	ns = static_cast<double>(monotonicNanoseconds() - start) / iterations;
+	allocations = threadAllocations() - allocations;
+
+	std::cout << std::left << std::setw(30) << name << std::right << std::fixed
+		<< std::setprecision(0) << std::setw(10) << ns << " ns/op"
+		<< std::setprecision(2) << std::setw(10) << static_cast<double>(allocations) / iterations
+		<< " allocs/op" << std::endl;
+}
+
+/* Registers MEMBERS users through the handlers and has them join #bench */
+static void	populate(Bench &bench)
+{
+	struct sockaddr_in	addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	for (int i = 0; i < MEMBERS; ++i) {
+		std::string const	nick = "member" + toString(i);
+		User				*user;
+
+		bench.server->createUser(FD_BASE + i, addr);
+		user = bench.server->findUserBySocket(FD_BASE + i);
+		exec(bench, *user, "PASS bench");
+		exec(bench, *user, "NICK " + nick);
+		exec(bench, *user, "USER " + nick + " 0 * :" + nick);
+		exec(bench, *user, "JOIN #bench");
+	}
+	bench.user = bench.server->findUserBySocket(FD_BASE);
+	bench.channel = bench.server->findChannel("#bench");
+}
+
+int	main()
+{
+	static const char	*lines[] = {
+		"PRIVMSG #general :hello everyone, how is it going?",
+		":alice!~a@127.0.0.1 PRIVMSG bob :direct message",
+		"JOIN #general,#random key1,key2",
+		"MODE #general +ovk alice bob secret",
+		"PING irc.serv.M.M.L",
+		"USER alice 0 * :Alice Liddell",
+		"TOPIC #general :a topic: with colons",
+		"KICK #general bob :spamming the channel",
+	};
+	Config	config;
+	Server	server("0", "bench", config);
+	Bench	bench;
+
+	server.setReactor(new NullReactor());
+	bench.server = &server;
+	bench.lines.assign(lines, lines + sizeof(lines) / sizeof(*lines));
+	for (size_t i = 0; i < 16; ++i)
+		bench.burst += bench.lines[i % bench.lines.size()] + "\r\n";
+	bench.next = 0;
+	bench.sink = 0;
+	populate(bench);
+	if (!bench.user || !bench.channel)
+		return (1);
+
+	std::cout << "hot paths, channel of " << MEMBERS << " members, replies to a null sink" << std::endl;
+	measure(bench, "parseMessage", parseLine, ITERATIONS * 10);
+	measure(bench, "InputBuffer, 16 lines", frameBurst, ITERATIONS);
+	measure(bench, "Reply RPL_WHOREPLY", formatReply, ITERATIONS * 10);
+	measure(bench, "macro CMD_NOTICE_TARGET", formatMacro, ITERATIONS * 10);
+	measure(bench, "PRIVMSG #bench", privmsgChannel, ITERATIONS);
+	measure(bench, "NAMES, cached", namesCached, ITERATIONS);
+	measure(bench, "NAMES, rebuilt", namesRebuilt, ITERATIONS);
+	measure(bench, "WHO #bench", whoChannel, ITERATIONS / 10);
+	return (bench.sink == 0);
+}
@@ -0,0 +1,501 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cerrno>
+#include <cstdio>
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "Metrics.hpp"
+#include "Utils.hpp"
+
+/*
+Load generator: connects clients to a running ircserv, registers
+them, fills channels of the requested sizes and has the clients
+send PRIVMSG to their channel at a fixed total rate. Every message
+carries its send time, so each delivery gives a latency sample.
+Single-threaded, on one edge-triggered epoll instance.
+*/
+
+# define LOADGEN_USAGE "usage: ./loadgen <port> <password> [--scenario=small|mixed|crowd] [--host=ADDRESS] [--clients=N] [--channel-sizes=N,N,...] [--rate=MESSAGES_PER_SECOND] [--duration=SECONDS]"
+
+# define EVENTS_MAX 1024
+# define CONNECTING_MAX 256
+# define SETUP_TIMEOUT 60
+# define DRAIN_TIMEOUT 5
+# define READ_SIZE 65536
+
+struct Options {
+	std::string			scenario;
+	std::string			host;
+	size_t				clients;
+	std::vector<size_t>	channelSizes;
+	size_t				rate;
+	size_t				duration;
+};
+
+enum State {
+	STATE_IDLE,
+	STATE_CONNECTING,
+	STATE_REGISTERING,
+	STATE_JOINING,
+	STATE_READY,
+	STATE_FAILED
+};
+
+struct Client {
+	int			fd;
+	State		state;
+	size_t		channel;
+	std::string	input;
+	std::string	output;
+};
+
+struct Run {
+	Options					options;
+	std::vector<Client>		clients;
+	std::vector<size_t>		channelMembers;
+	int						epollfd;
+	struct sockaddr_in		addr;
+	std::string				password;
+	size_t					connecting;
+	size_t					next;
+	size_t					ready;
+	size_t					failed;
+	unsigned long			sent;
+	unsigned long			expected;
+	unsigned long			delivered;
+	LatencyHistogram		latency;
+	unsigned long			maxLatency;
+};
+
+/******************************************************************************/
+/*									OPTIONS									  */
+/******************************************************************************/
+
+/* Presets run by make bench, the other options override their values */
+static bool	applyScenario(Options &options, std::string const &name)
+{
+	static size_t const	small[] = {10};
+	static size_t const	mixed[] = {2, 2, 2, 5, 10, 50, 500};
+	static size_t const	crowd[] = {1000};
+
+	options.scenario = name;
+	options.duration = 5;
+	if (name == "small") {
+		options.clients = 2000;
+		options.channelSizes.assign(small, small + sizeof(small) / sizeof(*small));
+		options.rate = 20000;
+	} else if (name == "mixed") {
+		options.clients = 5000;
+		options.channelSizes.assign(mixed, mixed + sizeof(mixed) / sizeof(*mixed));
+		options.rate = 1000;
+	} else if (name == "crowd") {
+		options.clients = 1000;
+		options.channelSizes.assign(crowd, crowd + sizeof(crowd) / sizeof(*crowd));
+		options.rate = 200;
+	} else
+		return (false);
+	return (true);
+}
+
+/* Converts a strictly positive number, 0 when invalid */
+static size_t	toCount(std::string const &value)
+{
+	char			*end;
+	unsigned long	count;
+
+	if (value.empty() || value[0] == '-')
+		return (0);
+	count = strtoul(value.c_str(), &end, 10);
+	return (*end ? 0 : count);
+}
+
+static bool	parseSizes(std::string const &value, std::vector<size_t> &sizes)
+{
+	size_t	start = 0;
+	size_t	comma;
+
+	sizes.clear();
+	while (start <= value.length()) {
+		comma = value.find(',', start);
+		if (comma == std::string::npos)
+			comma = value.length();
+		sizes.push_back(toCount(value.substr(start, comma - start)));
+		if (!sizes.back())
+			return (false);
+		start = comma + 1;
+	}
+	return (true);
+}
+
+static bool	parseOptions(int argc, char **argv, Options &options)
+{
+	applyScenario(options, "small");
+	options.host = "127.0.0.1";
+	for (int i = 3; i < argc; ++i) {
+		std::string const	arg(argv[i]);
+		size_t const		equal = arg.find('=');
+		std::string const	option = arg.substr(0, equal);
+		std::string const	value = (equal == std::string::npos) ? "" : arg.substr(equal + 1);
+
+		if (option == "--scenario" && applyScenario(options, value))
+			continue ;
+		else if (option == "--host" && !value.empty())
+			options.host = value;
+		else if (option == "--clients" && toCount(value))
+			options.clients = toCount(value);
+		else if (option == "--channel-sizes" && parseSizes(value, options.channelSizes))
+			continue ;
+		else if (option == "--rate" && toCount(value))
+			options.rate = toCount(value);
+		else if (option == "--duration" && toCount(value))
+			options.duration = toCount(value);
+		else
+			return (false);
+	}
+	return (true);
+}
+
+/******************************************************************************/
+/*									CLIENTS									  */
+/******************************************************************************/
+
+/* Writes what the socket takes, the rest waits for EPOLLOUT */
+static bool	flush(Client &client)
+{
+	ssize_t	n;
+
+	while (!client.output.empty()) {
+		n = send(client.fd, client.output.data(), client.output.size(), MSG_NOSIGNAL);
+		if (n == -1)
+			return (errno == EAGAIN || errno == EWOULDBLOCK);
+		client.output.erase(0, n);
+	}
+	return (true);
+}
+
+static void	queue(Client &client, std::string const &line)
+{
+	client.output += line;
+	client.output += "\r\n";
+}
+
+static void	fail(Run &run, Client &client)
+{
+	if (client.state == STATE_CONNECTING)
+		--run.connecting;
+	if (client.state != STATE_READY && client.state != STATE_FAILED)
+		++run.failed;
+	client.state = STATE_FAILED;
+	close(client.fd);
+	client.fd = -1;
+}
+
+static std::string	channelName(size_t channel)
+{
+	return ("#lg" + toString(channel));
+}
+
+/* Starts connecting the next clients, keeping CONNECTING_MAX handshakes in flight */
+static void	connectClients(Run &run)
+{
+	struct epoll_event	ev;
+	int					one = 1;
+
+	while (run.next < run.clients.size() && run.connecting < CONNECTING_MAX) {
+		Client	&client = run.clients[run.next];
+
+		client.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+		client.state = STATE_CONNECTING;
+		++run.connecting;
+		ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+		ev.data.u64 = run.next++;
+		if (client.fd == -1
+			|| setsockopt(client.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) == -1
+			|| (connect(client.fd, (struct sockaddr *)&run.addr, sizeof(run.addr)) == -1 && errno != EINPROGRESS)
+			|| epoll_ctl(run.epollfd, EPOLL_CTL_ADD, client.fd, &ev) == -1) {
+			fail(run, client);
+			continue ;
+		}
+	}
+}
+
+/* Numeric of a server reply, 0 for the other lines */
+static int	numeric(std::string const &line)
+{
+	size_t const	space = line.find(' ');
+
+	if (line.empty() || line[0] != ':' || space == std::string::npos || line.length() < space + 5
+		|| line[space + 4] != ' ')
+		return (0);
+	return (atoi(line.c_str() + space + 1));
+}
+
+/* Takes the send time out of a channel message and records the delay */
+static void	delivery(Run &run, std::string const &line, unsigned long now)
+{
+	size_t const	colon = line.find(" :");
+	unsigned long	sentAt;
+	unsigned long	delay;
+
+	if (colon == std::string::npos)
+		return ;
+	sentAt = strtoul(line.c_str() + colon + 2, NULL, 10);
+	delay = (now > sentAt) ? now - sentAt : 0;
+	run.latency.record(delay);
+	if (delay > run.maxLatency)
+		run.maxLatency = delay;
+	++run.delivered;
+}
+
+static void	handleLine(Run &run, Client &client, std::string const &line, unsigned long now)
+{
+	int const	code = numeric(line);
+
+	if (line.find(" PRIVMSG #") != std::string::npos)
+		delivery(run, line, now);
+	else if (code == 1 && client.state == STATE_REGISTERING) {
+		client.state = STATE_JOINING;
+		queue(client, "JOIN " + channelName(client.channel));
+	} else if (code == 366 && client.state == STATE_JOINING) {
+		client.state = STATE_READY;
+		++run.ready;
+	} else if (line.compare(0, 6, "ERROR ") == 0 || code >= 400) {
+		std::cerr << "client " << (&client - &run.clients[0]) << ": " << line << std::endl;
+		fail(run, client);
+	}
+}
+
+/* Reads until the socket is empty, the events being edge-triggered */
+static void	readClient(Run &run, Client &client)
+{
+	char			buffer[READ_SIZE];
+	ssize_t			n;
+	size_t			start;
+	size_t			end;
+	unsigned long	now;
+
+	while ((n = recv(client.fd, buffer, sizeof(buffer), 0)) > 0) {
+		now = monotonicNanoseconds();
+		client.input.append(buffer, n);
+		start = 0;
+		while (client.state != STATE_FAILED && (end = client.input.find('\n', start)) != std::string::npos) {
+			handleLine(run, client, client.input.substr(start, end - start - (end > start && client.input[end - 1] == '\r')), now);
+			start = end + 1;
+		}
+		if (client.state == STATE_FAILED)
+			return ;
+		client.input.erase(0, start);
+	}
+	if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+		std::cerr << "client " << (&client - &run.clients[0]) << ": connection closed by the server" << std::endl;
+		fail(run, client);
+	}
+}
+
+/* Sends the registration once the handshake is over */
+static void	connected(Run &run, Client &client)
+{
+	int			error = 0;
+	socklen_t	length = sizeof(error);
+	std::string	nick;
+
+	--run.connecting;
+	if (getsockopt(client.fd, SOL_SOCKET, SO_ERROR, &error, &length) == -1 || error) {
+		client.state = STATE_IDLE;
+		std::cerr << "client " << (&client - &run.clients[0]) << ": " << strerror(error) << std::endl;
+		fail(run, client);
+		return ;
+	}
+	nick = "lg" + toString(&client - &run.clients[0]);
+	client.state = STATE_REGISTERING;
+	queue(client, "PASS " + run.password);
+	queue(client, "NICK " + nick);
+	queue(client, "USER " + nick + " 0 * :" + nick);
+}
+
+/* Waits up to timeout milliseconds and handles the events */
+static void	waitEvents(Run &run, int timeout)
+{
+	struct epoll_event	events[EVENTS_MAX];
+	int					nfds;
+
+	nfds = epoll_wait(run.epollfd, events, EVENTS_MAX, timeout);
+	for (int i = 0; i < nfds; ++i) {
+		Client	&client = run.clients[events[i].data.u64];
+
+		if (client.state == STATE_FAILED)
+			continue ;
+		if (client.state == STATE_CONNECTING && (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+			connected(run, client);
+		if (client.state != STATE_FAILED && (events[i].events & EPOLLIN))
+			readClient(run, client);
+		if (client.state != STATE_FAILED && !flush(client))
+			fail(run, client);
+	}
+}
+
+/******************************************************************************/
+/*									PHASES									  */
+/******************************************************************************/
+
+/* Fills the channels one after the other, cycling through the sizes */
+static void	assignChannels(Run &run)
+{
+	size_t	channel = 0;
+	size_t	size = run.options.channelSizes[0];
+
+	run.channelMembers.assign(1, 0);
+	for (size_t i = 0; i < run.clients.size(); ++i) {
+		if (run.channelMembers[channel] == size) {
+			++channel;
+			size = run.options.channelSizes[channel % run.options.channelSizes.size()];
+			run.channelMembers.push_back(0);
+		}
+		run.clients[i].fd = -1;
+		run.clients[i].state = STATE_IDLE;
+		run.clients[i].channel = channel;
+		++run.channelMembers[channel];
+	}
+}
+
+/* Connects, registers and joins every client */
+static bool	setup(Run &run)
+{
+	unsigned long const	deadline = monotonicNanoseconds() + SETUP_TIMEOUT * 1000000000UL;
+
+	while (run.ready + run.failed < run.clients.size()) {
+		connectClients(run);
+		waitEvents(run, 10);
+		if (run.failed || monotonicNanoseconds() > deadline)
+			return (false);
+	}
+	return (true);
+}
+
+/* Sends the messages due at the requested rate, round-robin over the clients */
+static void	pump(Run &run, unsigned long start, unsigned long now)
+{
+	unsigned long const	due = (now - start) / 1000 * run.options.rate / 1000000;
+	size_t				index = run.sent % run.clients.size();
+	char				line[64];
+
+	while (run.sent < due) {
+		Client	&client = run.clients[index];
+
+		snprintf(line, sizeof(line), "PRIVMSG #lg%lu :%lu", (unsigned long)client.channel, monotonicNanoseconds());
+		queue(client, line);
+		if (!flush(client))
+			fail(run, client);
+		run.expected += run.channelMembers[client.channel] - 1;
+		++run.sent;
+		index = (index + 1) % run.clients.size();
+	}
+}
+
+/* Sends for the requested duration, then waits for the late deliveries */
+static void	measure(Run &run)
+{
+	unsigned long const	start = monotonicNanoseconds();
+	unsigned long const	end = start + run.options.duration * 1000000000UL;
+	unsigned long		now;
+
+	while ((now = monotonicNanoseconds()) < end && !run.failed) {
+		pump(run, start, now);
+		waitEvents(run, 1);
+	}
+	while (run.delivered < run.expected && !run.failed
+		&& monotonicNanoseconds() < end + DRAIN_TIMEOUT * 1000000000UL)
+		waitEvents(run, 10);
+}
+
+/******************************************************************************/
+/*									REPORT									  */
+/******************************************************************************/
+
+static void	report(Run const &run, double setupTime)
+{
+	double const	duration = run.options.duration;
+
+	std::cout << std::fixed << std::setprecision(0);
+	std::cout << "scenario " << (run.options.scenario.empty() ? "custom" : run.options.scenario) << ": "
+		<< run.clients.size() << " clients, " << run.channelMembers.size() << " channel(s)" << std::endl;
+	std::cout << "  setup      " << std::setprecision(2) << setupTime << " s" << std::setprecision(0) << std::endl;
+	std::cout << "  sent       " << run.sent << " msgs, " << run.sent / duration << " msgs/s" << std::endl;
+	std::cout << "  delivered  " << run.delivered << " of " << run.expected << " msgs, "
+		<< run.delivered / duration << " msgs/s" << std::endl;
+	std::cout << "  latency    p50 " << run.latency.quantile(0.5) / 1000
+		<< " us, p99 " << run.latency.quantile(0.99) / 1000
+		<< " us, p999 " << run.latency.quantile(0.999) / 1000
+		<< " us, max " << run.maxLatency / 1000 << " us" << std::endl;
+}
+
+/* Each client needs a descriptor, raises the soft limit as far as allowed */
+static void	raiseFileLimit()
+{
+	struct rlimit	limit;
+
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+}
+
+int	main(int argc, char **argv)
+{
+	Run				run;
+	unsigned long	start;
+	double			setupTime;
+
+	if (argc < 3 || !parseOptions(argc, argv, run.options) || toCount(argv[1]) == 0) {
+		std::cerr << LOADGEN_USAGE << std::endl;
+		return (1);
+	}
+	memset(&run.addr, 0, sizeof(run.addr));
+	run.addr.sin_family = AF_INET;
+	run.addr.sin_port = htons(toCount(argv[1]));
+	if (inet_pton(AF_INET, run.options.host.c_str(), &run.addr.sin_addr) != 1) {
+		std::cerr << "loadgen: invalid host " << run.options.host << std::endl;
+		return (1);
+	}
+	run.password = argv[2];
+	run.connecting = 0;
+	run.next = 0;
+	run.ready = 0;
+	run.failed = 0;
+	run.sent = 0;
+	run.expected = 0;
+	run.delivered = 0;
+	run.maxLatency = 0;
+	run.clients.resize(run.options.clients);
+	assignChannels(run);
+	raiseFileLimit();
+	run.epollfd = epoll_create1(0);
+	if (run.epollfd == -1)
+		return (1);
+
+	start = monotonicNanoseconds();
+	if (!setup(run)) {
+		std::cerr << "loadgen: " << run.ready << " of " << run.clients.size() << " clients joined their channel" << std::endl;
+		return (1);
+	}
+	setupTime = (monotonicNanoseconds() - start) / 1e9;
+	measure(run);
+	report(run, setupTime);
+	for (size_t i = 0; i < run.clients.size(); ++i)
+		if (run.clients[i].fd != -1)
+			close(run.clients[i].fd);
+	close(run.epollfd);
+	return (run.failed || run.delivered < run.expected);
+}
@@ -0,0 +1,98 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <ctime>
+
+#include "Message.hpp"
+
+/*
+Parser benchmark: parseMessage against the stringstream splitting
+it replaced, on a mix of typical client lines.
+*/
+
+# define ITERATIONS 200000
+
+/* Splitting done by Server::parseCommands before parseMessage */
+static void	legacyParse(
+	std::string &s,
+	std::string &cmd,
+	std::vector<std::string> &args,
+	std::string &mess
+) {
+	size_t  pos;
+
+	pos = s.find('\r');
+	if (pos != std::string::npos) {
+		s = s.substr(0, pos);
+	}
+
+	pos = s.find(':');
+	if (pos != std::string::npos) {
+		mess = s.substr(++pos);
+	}
+
+	std::stringstream ss(s.substr(0, --pos));
+	std::string token;
+
+	std::getline(ss, cmd, ' ');
+	while (std::getline(ss, token, ' ')) {
+		args.push_back(token);
+		token.clear();
+	}
+}
+
+static double	now()
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1e9 + ts.tv_nsec);
+}
+
+int	main()
+{
+	static const char	*lines[] = {
+		"PRIVMSG #general :hello everyone, how is it going?\r",
+		":alice!~a@127.0.0.1 PRIVMSG bob :direct message\r",
+		"JOIN #general,#random key1,key2\r",
+		"MODE #general +ovk alice bob secret\r",
+		"PING irc.serv.M.M.L\r",
+		"USER alice 0 * :Alice Liddell\r",
+		"TOPIC #general :a topic: with colons\r",
+		"KICK #general bob :spamming the channel\r",
+	};
+	const size_t		count = sizeof(lines) / sizeof(*lines);
+	std::vector<std::string>	input(lines, lines + count);
+	size_t				sink = 0;
+	double				start;
+	double				legacy;
+	double				parser;
+
+	start = now();
+	for (size_t i = 0; i < ITERATIONS; ++i) {
+		std::string					s = input[i % count];
+		std::string					cmd;
+		std::string					mess;
+		std::vector<std::string>	args;
+
+		legacyParse(s, cmd, args, mess);
+		sink += args.size() + cmd.length();
+	}
+	legacy = (now() - start) / ITERATIONS;
+
+	start = now();
+	for (size_t i = 0; i < ITERATIONS; ++i) {
+		std::string const	&s = input[i % count];
+		Message				message;
+
+		parseMessage(s.data(), s.length(), message);
+		sink += message.paramCount + message.command.length;
+	}
+	parser = (now() - start) / ITERATIONS;
+
+	std::cout << "legacy parseCommands  " << legacy << " ns/line" << std::endl;
+	std::cout << "parseMessage          " << parser << " ns/line" << std::endl;
+	std::cout << "speedup               " << legacy / parser << "x" << std::endl;
+	return (sink == 0);
+}
@@ -0,0 +1,134 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <ctime>
+
+#include "Channel.hpp"
+
+/*
+Reply benchmark: the replies sent to a user joining a channel of
+MEMBERS users, formatted by Reply against the std::string macros
+it replaced, both ending in the SharedBuffer that is queued.
+*/
+
+# define ITERATIONS 20000
+# define MEMBERS 16
+
+# define LEGACY_JOIN(sender, chanName)									((std::string)sender + " JOIN :" + chanName + "\r\n");
+# define LEGACY_TOPIC(nickName, chanName, chanTopic)					((std::string)SERVER_NAME + "332 " + nickName + " " + chanName + " :" + chanTopic + "\r\n");
+# define LEGACY_TOPICWHOTIME(nickName, chanName, creator, creationTime)	((std::string)SERVER_NAME + "333 " + nickName + " " + chanName + " " + creator + " " + creationTime + "\r\n");
+# define LEGACY_CREATIONTIME(nickName, chanName, creationTime)			((std::string)SERVER_NAME + "329 " + nickName + " " + chanName + " " + creationTime + "\r\n");
+# define LEGACY_NAMREPLY(nickName, chanName, userList)					((std::string)SERVER_NAME + "353 " + nickName + " = " + chanName + " :" + userList + "\r\n");
+# define LEGACY_ENDOFNAMES(nickName, chanName)							((std::string)SERVER_NAME + "366 " + nickName + " " + chanName + " :End of /NAMES list.\r\n");
+# define LEGACY_WHOREPLY(nickName, chanName, informationUserList)		((std::string)SERVER_NAME + "352 " + nickName + " " + chanName + " " + informationUserList + "\r\n");
+# define LEGACY_ENDOFWHO(nickName, chanName)							((std::string)SERVER_NAME + "315 " + nickName + " " + chanName + " :End of /WHO list.\r\n");
+
+struct Member {
+	std::string	nick;
+	std::string	sender;
+	std::string	username;
+	bool		op;
+};
+
+static double	now()
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1e9 + ts.tv_nsec);
+}
+
+/* Burst of the macros, each string copied into its buffer */
+static size_t	legacyBurst(std::string const &nick, std::string const &sender, std::string const &chan,
+	std::string const &topic, std::string const &time, std::string const &names, std::vector<Member> const &members)
+{
+	std::string	mess;
+	std::string	informationUserList;
+	size_t		sink = 0;
+
+	mess = LEGACY_JOIN(sender, chan);
+	sink += SharedBuffer(mess).length();
+	mess = LEGACY_TOPIC(nick, chan, topic);
+	sink += SharedBuffer(mess).length();
+	mess = LEGACY_TOPICWHOTIME(nick, chan, nick, time);
+	sink += SharedBuffer(mess).length();
+	mess = LEGACY_CREATIONTIME(nick, chan, time);
+	sink += SharedBuffer(mess).length();
+	mess = LEGACY_NAMREPLY(nick, chan, names);
+	sink += SharedBuffer(mess).length();
+	mess = LEGACY_ENDOFNAMES(nick, chan);
+	sink += SharedBuffer(mess).length();
+	for (size_t i = 0; i < members.size(); ++i) {
+		Member const	&m = members[i];
+
+		informationUserList = m.nick + " " + m.sender + " " + m.username + " :" + (m.op ? "@" : "");
+		mess = LEGACY_WHOREPLY(nick, chan, informationUserList);
+		sink += SharedBuffer(mess).length();
+	}
+	mess = LEGACY_ENDOFWHO(nick, chan);
+	sink += SharedBuffer(mess).length();
+	return (sink);
+}
+
+/* Same burst written by Reply */
+static size_t	replyBurst(std::string const &nick, std::string const &sender, std::string const &chan,
+	std::string const &topic, std::string const &time, std::string const &names, std::vector<Member> const &members)
+{
+	size_t	sink = 0;
+
+	sink += Reply(CMD_JOIN).arg(sender).arg(chan).buffer().length();
+	sink += Reply(RPL_TOPIC).arg(nick).arg(chan).arg(topic).buffer().length();
+	sink += Reply(RPL_TOPICWHOTIME).arg(nick).arg(chan).arg(nick).arg(time).buffer().length();
+	sink += Reply(RPL_CREATIONTIME).arg(nick).arg(chan).arg(time).buffer().length();
+	sink += Reply(RPL_NAMREPLY).arg(nick).arg(chan).arg(names).buffer().length();
+	sink += Reply(RPL_ENDOFNAMES).arg(nick).arg(chan).buffer().length();
+	for (size_t i = 0; i < members.size(); ++i) {
+		Member const	&m = members[i];
+
+		sink += Reply(RPL_WHOREPLY).arg(nick).arg(chan).arg(m.nick).arg(m.sender).arg(m.username).arg(m.op ? "@" : "").buffer().length();
+	}
+	sink += Reply(RPL_ENDOFWHO).arg(nick).arg(chan).buffer().length();
+	return (sink);
+}
+
+int	main()
+{
+	std::string const	nick = "alice";
+	std::string const	sender = ":alice!~alice@127.0.0.1";
+	std::string const	chan = "#general";
+	std::string const	topic = "Welcome to #general!";
+	std::string const	time = "1712345678";
+	std::vector<Member>	members;
+	std::string			names;
+	size_t				sink = 0;
+	double				start;
+	double				legacy;
+	double				reply;
+
+	for (size_t i = 0; i < MEMBERS; ++i) {
+		Member	m;
+
+		m.nick = "member" + toString(i);
+		m.sender = ":" + m.nick + "!~" + m.nick + "@127.0.0.1";
+		m.username = m.nick;
+		m.op = (i == 0);
+		members.push_back(m);
+		names += (m.op ? "@" : "") + m.nick + " ";
+	}
+
+	start = now();
+	for (size_t i = 0; i < ITERATIONS; ++i)
+		sink += legacyBurst(nick, sender, chan, topic, time, names, members);
+	legacy = (now() - start) / ITERATIONS;
+
+	start = now();
+	for (size_t i = 0; i < ITERATIONS; ++i)
+		sink += replyBurst(nick, sender, chan, topic, time, names, members);
+	reply = (now() - start) / ITERATIONS;
+
+	std::cout << "JOIN burst, " << MEMBERS << " members" << std::endl;
+	std::cout << "string macros         " << legacy << " ns/burst" << std::endl;
+	std::cout << "Reply                 " << reply << " ns/burst" << std::endl;
+	std::cout << "speedup               " << legacy / reply << "x" << std::endl;
+	return (sink == 0);
+}
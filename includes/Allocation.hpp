@@ -0,0 +1,13 @@
+#ifndef _ALLOCATION_HPP
+# define _ALLOCATION_HPP
+
+/*
+Counters of the global operator new, which is replaced to keep them:
+allocations made by the calling thread, and by the whole process.
+The difference of the thread counter around a piece of code is the
+number of heap allocations it made, whatever the other threads do.
+*/
+unsigned long	threadAllocations();
+unsigned long	totalAllocations();
+
+#endif
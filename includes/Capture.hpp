@@ -0,0 +1,81 @@
+#ifndef _CAPTURE_HPP
+# define _CAPTURE_HPP
+
+# include <string>
+# include <cstdio>
+# include <stdint.h>
+# include <netinet/in.h>
+
+# define CAPTURE_MAGIC "IRCCAP1\n"
+# define CAPTURE_MAGIC_LENGTH 8
+# define CAPTURE_HEADER_LENGTH 17
+# define CAPTURE_ADDRESS_LENGTH 6
+# define CAPTURE_BUFFER_SIZE (1 << 20)
+# define CAPTURE_PAYLOAD_MAX (1 << 20)
+# define CAPTURE_SOCKET_MAX (1 << 20)
+
+enum CaptureEvent {
+	CAPTURE_OPEN = 1,
+	CAPTURE_DATA = 2,
+	CAPTURE_CLOSE = 3
+};
+
+/*
+Event of a capture file, stored after the magic as a header of the
+nanoseconds since the capture started (8 bytes), the socket (4), the
+payload length (4) and the event (1), in host byte order, followed by
+the payload: the IPv4 address and port of the peer for an open,
+the bytes read for data, nothing for a close.
+*/
+struct CaptureRecord {
+	uint64_t		time;
+	uint32_t		socket;
+	uint8_t			event;
+	std::string		payload;
+};
+
+/*
+Records the inbound traffic of every connection, as the server
+thread sees it, into a buffered capture file for --replay.
+*/
+class Capture {
+
+public:
+	static void	start(std::string const &path);
+	static void	stop();
+	static bool	enabled() { return (_file != NULL); }
+
+	static void	open(int socket, struct sockaddr_in const &addr);
+	static void	data(int socket, const char *data, size_t length);
+	static void	close(int socket);
+
+private:
+	static void	write(int socket, CaptureEvent event, const char *payload, size_t length);
+
+	static FILE				*_file;
+	static unsigned long	_start;
+};
+
+/*
+Reads the records of a capture file back in order, checking each
+payload length against the bytes left and CAPTURE_PAYLOAD_MAX,
+and each socket against the open files limit
+*/
+class CaptureReader {
+
+public:
+	explicit CaptureReader(std::string const &path);
+	~CaptureReader();
+
+	bool	next(CaptureRecord &record);
+
+private:
+	CaptureReader(CaptureReader const &other);
+	CaptureReader	&operator=(CaptureReader const &other);
+
+	FILE			*_file;
+	unsigned long	_remaining;
+	unsigned long	_socketMax;
+};
+
+#endif
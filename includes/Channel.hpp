@@ -6,25 +6,30 @@
 # include <map>
 
 # include "Utils.hpp"
+# include "MemberList.hpp"
+# include "PointerMap.hpp"
+# include "ObjectPool.hpp"
 # include "User.hpp"
 # include "Server.hpp"
 
-# define CMD_JOIN(sender, chanName)										((std::string)sender + " JOIN :" + chanName + "\r\n");
+# define CHANNEL_POOL_SLAB 32
+
+# define CMD_JOIN														"% JOIN :%"
 # define CMD_PART(sender, chanName, reason)								((std::string)sender + " PART " + chanName + " :" + reason + "\r\n");
 # define CMD_QUIT(sender, reason)										((std::string)sender + " QUIT :" + reason + "\r\n");
-# define CMD_TOPIC(sender, chanName, topic)								((std::string)sender + " TOPIC " + chanName + " " + " :" + topic + "\r\n");
+# define CMD_TOPIC(sender, chanName, topic)								((std::string)sender + " TOPIC " + chanName + " :" + topic + "\r\n");
 # define CMD_KICK(sender, chanName, kickedUser, reason)					((std::string)sender + " KICK " + chanName + " " + kickedUser + " :" + reason + "\r\n");
 # define CMD_MODE(sender, chanName, sign, option, mess)					((std::string)sender + " MODE "  + chanName + " " + sign + "" + option + " " + mess + "\r\n");
 # define CMD_INVITE(sender, invitedNick, chanName)						((std::string)sender + " INVITE " + invitedNick + " " + chanName + "\r\n");
 
-# define RPL_ENDOFWHO(nickName, chanName)								((std::string)SERVER_NAME + "315 " + nickName + " " + chanName + " :End of /WHO list.\r\n");
-# define RPL_CREATIONTIME(nickName, chanName, creationTime)				((std::string)SERVER_NAME + "329 " + nickName + " " + chanName + " " + creationTime + "\r\n");
-# define RPL_TOPIC(nickName, chanName, chanTopic)						((std::string)SERVER_NAME + "332 " + nickName + " " + chanName + " :" + chanTopic + "\r\n");
-# define RPL_TOPICWHOTIME(nickName, chanName, creator, creationTime)	((std::string)SERVER_NAME + "333 " + nickName + " " + chanName + " " + creator + " " + creationTime + "\r\n");
+# define RPL_ENDOFWHO													SERVER_NAME "315 % % :End of /WHO list."
+# define RPL_CREATIONTIME												SERVER_NAME "329 % % %"
+# define RPL_TOPIC														SERVER_NAME "332 % % :%"
+# define RPL_TOPICWHOTIME												SERVER_NAME "333 % % % %"
 # define RPL_INVITE(invitingNick, invitedNick, chanName)				((std::string)SERVER_NAME + "341 " + invitingNick + " " + invitedNick  + " " + chanName +" :Invitation sent to " + invitedNick + "\r\n");
-# define RPL_WHOREPLY(nickName, chanName, informationUserList)			((std::string)SERVER_NAME + "352 " + nickName + " " + chanName + " " + informationUserList + "\r\n");
-# define RPL_NAMREPLY(nickName, chanName, userList)  					((std::string)SERVER_NAME + "353 " + nickName + " = " + chanName + " :" + userList + "\r\n");
-# define RPL_ENDOFNAMES(nickName, chanName)								((std::string)SERVER_NAME + "366 " + nickName + " " + chanName + " :End of /NAMES list.\r\n");
+# define RPL_WHOREPLY													SERVER_NAME "352 % % % % % :%"
+# define RPL_NAMREPLY													SERVER_NAME "353 % = % :%"
+# define RPL_ENDOFNAMES													SERVER_NAME "366 % % :End of /NAMES list."
 
 # define ERR_CHANNOTINLIST(nickName, chanName, attemptedKicked)			((std::string)SERVER_NAME + "441 " + nickName + " " + chanName + " :" + attemptedKicked + " is not on that channel" + "\r\n");
 # define ERR_NOTONCHANNEL(nickName, chanName)							((std::string)SERVER_NAME + "442 " + nickName + " " + chanName + " :You're not on that channel\r\n");																						   
@@ -45,10 +50,13 @@ public:
 	Channel(const std::string name, const std::string creator, const std::string time);
 	~Channel();
 
+	static void	*operator new(size_t size);
+	static void	operator delete(void *ptr, size_t size);
+
 	//SETTERS AND GETTERS
 	void							setName(std::string const & name);
 	const std::string				&getName() const;
-	const std::map<User *, bool>	&getMembers() const;
+	const MemberList				&getMembers() const;
 	const std::string				&getTopic() const;
 	const std::string				&getTopicUpdateUser() const;
 	const std::string				&getTopicUpdateTimestamp() const;
@@ -59,23 +67,24 @@ public:
 	bool	partUser(Server const &server, User &leavingUser, std::string const &reason);
 	bool	kickUser(Server const &server, User &kickedUser, User &kickerUser, std::string const &reason);
 	void	inviteUser(Server const &server, User &invitedUser, User &invitingUser);
-	void	quit(Server const &server, User &quiter, std::string const &reason);
 	void	removeUser(User & user);
 
 	//UPDATES
 	void	updateTopic(Server const &server, User &user, std::string const &topic);
 	void	updateMode(Server const &server, User &user, std::vector<std::string> const &args);
-	void	updateUserList();
+	void	invalidateNames();
 
 	//INFORMATION ABOUT USERS
 	bool	userIsOP(User &user);
 	bool	userOnChannel(User &user);
 	void	who(Server const &server, User &user, bool checkNeeded);
+	void	names(Server const &server, User &user);
 
 private:
 	std::string				_name;
 
-	std::string				_userList;
+	std::vector<std::string>	_names;
+	bool					_namesCached;
 	size_t					_userLimit;
 	bool					_inviteOnly;
 	std::string				_creator;
@@ -91,8 +100,10 @@ private:
 
 	std::string		 		_operatorList;
 
-	std::map<User *, bool>	_members;
-	std::vector<User *>		_pendingUserInvitations;
+	MemberList				_members;
+	PointerMap				_pendingUserInvitations;
+
+	void	buildNames();
 };
 
 #endif
\ No newline at end of file
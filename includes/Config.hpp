@@ -0,0 +1,42 @@
+#ifndef _CONFIG_HPP
+# define _CONFIG_HPP
+
+# include <string>
+# include <stdexcept>
+
+# include "Logger.hpp"
+
+# define REACTORS_MAX 64
+# define BACKLOG_DEFAULT 4096
+# define ACCEPT_BUDGET_DEFAULT 64
+# define SENDQ_DEFAULT 1048576
+
+# define USAGE "usage ./ircserv <port> <password> [--edge-triggered] [--backend=epoll|uring] [--reactors=N] [--backlog=N] [--accept-budget=N] [--flood-limit=SECONDS] [--sendq=BYTES] [--alloc-stats] [--log-level=debug|info|warn|error|off] [--log-file=PATH] [--metrics-socket=PATH] [--oper-password=PASSWORD] [--capture=PATH] [--replay=PATH] [--replay-pacing=full|recorded]"
+
+/*
+Optional runtime settings, given on the command line
+after the port and the password as --name or --name=value.
+*/
+struct Config {
+	Config();
+
+	bool		edgeTriggered;
+	std::string	backend;
+	size_t		reactors;
+	size_t		backlog;
+	size_t		acceptBudget;
+	size_t		floodLimit;
+	size_t		sendqLimit;
+	bool		allocStats;
+	int			logLevel;
+	std::string	logFile;
+	std::string	metricsSocket;
+	std::string	operPassword;
+	std::string	capture;
+	std::string	replay;
+	bool		replayPaced;
+};
+
+void	parseConfig(int argc, char **argv, Config &config);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef _EPOLLREACTOR_HPP
+# define _EPOLLREACTOR_HPP
+
+# include <sys/epoll.h>
+# include <stdint.h>
+
+# include "Reactor.hpp"
+
+/* Readiness-based backend built on epoll, level or edge triggered */
+class EpollReactor : public Reactor {
+
+public:
+	EpollReactor(Server &server, Config const &config);
+	virtual ~EpollReactor();
+
+	virtual void	start(int socketServer);
+	virtual int		poll();
+	virtual int		addConnection(User &user);
+	virtual void	removeConnection(User &user);
+	virtual int		flush(User &user);
+
+private:
+	EpollReactor();
+	EpollReactor(EpollReactor const &src);
+	EpollReactor	&operator=(EpollReactor const &src);
+
+	void	handleEvents(int fd, struct epoll_event event);
+	void	acceptConnection();
+	int		receiveData(User &user);
+
+	Server			&_server;
+	bool			_edgeTriggered;
+	size_t			_acceptBudget;
+	int				_socketServer;
+	int				_epollfd;
+	uint32_t		_epollEvents;
+	AcceptReserve	_reserve;
+};
+
+#endif
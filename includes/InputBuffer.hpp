@@ -0,0 +1,40 @@
+#ifndef _INPUTBUFFER_HPP
+# define _INPUTBUFFER_HPP
+
+# include <vector>
+# include <cstddef>
+# include <string.h>
+
+# include "Message.hpp"
+
+/*
+Inbound bytes of a connection, framed into lines in place.
+The reactor writes at the end (append, or reserve then commit),
+the server reads complete lines as views on the buffer, then compacts
+it once per batch so that only the unfinished line is moved.
+A view stays valid until the next append, reserve or compact.
+Lines longer than MESSAGE_LENGTH_MAX, CRLF included, are truncated
+and the rest is dropped as it arrives, which bounds the buffer.
+*/
+class InputBuffer {
+
+public:
+	InputBuffer();
+	~InputBuffer();
+
+	void	append(const char *data, size_t length);
+	char	*reserve(size_t length);
+	void	commit(size_t length);
+	bool	nextLine(const char *&line, size_t &length);
+	void	unscanned(const char *&data, size_t &length) const;
+	void	compact();
+	size_t	size() const;
+
+private:
+	std::vector<char>	_data;
+	size_t				_start;
+	size_t				_scan;
+	size_t				_end;
+};
+
+#endif
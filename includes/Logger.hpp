@@ -0,0 +1,87 @@
+#ifndef _LOGGER_HPP
+# define _LOGGER_HPP
+
+# include <string>
+# include <cstddef>
+# include <ctime>
+# include <pthread.h>
+
+# define LEVEL_DEBUG 0
+# define LEVEL_INFO 1
+# define LEVEL_WARN 2
+# define LEVEL_ERROR 3
+# define LEVEL_OFF 4
+
+/* Logs under this level are compiled out, build with -DLOG_LEVEL_MIN=0 to keep debug logs */
+# ifndef LOG_LEVEL_MIN
+#  define LOG_LEVEL_MIN LEVEL_INFO
+# endif
+
+# define LOG_RING_SLOTS 4096
+# define LOG_LINE_MAX 224
+# define LOG_FLUSH_INTERVAL 10000
+
+/*
+LOG_INFO << "text" << 42; writes one line, with nothing evaluated
+when the level is compiled out or disabled at runtime.
+*/
+# define LOG(level)	for (bool logOnce = (level) >= LOG_LEVEL_MIN && Logger::enabled(level); logOnce; logOnce = false) LogLine(level)
+# define LOG_DEBUG	LOG(LEVEL_DEBUG)
+# define LOG_INFO	LOG(LEVEL_INFO)
+# define LOG_WARN	LOG(LEVEL_WARN)
+# define LOG_ERROR	LOG(LEVEL_ERROR)
+
+/*
+Asynchronous logger: any thread copies its lines into a lock-free ring
+of LOG_RING_SLOTS fixed-size slots, a writer thread formats the
+timestamps and writes them in batches every LOG_FLUSH_INTERVAL
+microseconds. A line is dropped, and counted, when the ring is full,
+so logging never blocks the event loop.
+*/
+class Logger {
+
+public:
+	static void				start(int level, std::string const &path);
+	static void				stop();
+	static bool				enabled(int level) { return (level >= __atomic_load_n(&_level, __ATOMIC_RELAXED)); }
+	static void				publish(int level, struct timespec const &time, const char *data, size_t length);
+	static unsigned long	dropped();
+	static int				parseLevel(std::string const &name);
+
+private:
+	static void		*writer(void *arg);
+	static size_t	drain(std::string &batch);
+
+	static int			_level;
+	static int			_fd;
+	static bool			_running;
+	static bool			_stop;
+	static pthread_t	_thread;
+};
+
+/* One line being written, published to the ring when it is destroyed */
+class LogLine {
+
+public:
+	explicit LogLine(int level);
+	~LogLine();
+
+	LogLine	&operator<<(const char *str);
+	LogLine	&operator<<(std::string const &str);
+	LogLine	&operator<<(long n);
+	LogLine	&operator<<(unsigned long n);
+	LogLine	&operator<<(int n);
+	LogLine	&operator<<(unsigned int n);
+	LogLine	&write(const char *data, size_t length);
+
+private:
+	LogLine(LogLine const &other);
+	LogLine	&operator=(LogLine const &other);
+
+	int				_level;
+	struct timespec	_time;
+	char			_data[LOG_LINE_MAX];
+	size_t			_length;
+};
+
+#endif
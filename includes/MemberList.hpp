@@ -0,0 +1,65 @@
+#ifndef _MEMBERLIST_HPP
+# define _MEMBERLIST_HPP
+
+# include <vector>
+# include <cstddef>
+
+# include "PointerMap.hpp"
+
+# define MEMBER_OP 0x1
+# define MEMBER_VOICE 0x2
+# define MEMBERSHIP_POOL_SLAB 256
+
+class User;
+class Channel;
+
+/*
+A user on a channel with its mode bits (MEMBER_OP, MEMBER_VOICE).
+The record is linked into the member list of the channel and into
+the membership list of the user, and knows its slot in both,
+so either side unlinks it without searching.
+Records come from a pool, a join and a part don't touch the heap.
+*/
+struct Membership {
+	static void	*operator new(size_t size);
+	static void	operator delete(void *ptr, size_t size);
+
+	User			*user;
+	Channel			*channel;
+	unsigned char	modes;
+	size_t			channelSlot;
+	size_t			userSlot;
+};
+
+/*
+Members of a channel, owning their membership records, kept contiguous
+so that a broadcast is a linear scan, plus an index from user to slot
+for constant-time membership tests.
+Removing a member moves the last one into its place,
+so the order of the list is not stable.
+*/
+class MemberList {
+
+public:
+	MemberList();
+	~MemberList();
+
+	Membership			*add(User *user, Channel *channel, unsigned char modes);
+	bool				remove(User *user);
+	Membership			*find(User *user);
+	Membership const	*find(User *user) const;
+	bool				contains(User *user) const;
+
+	size_t				size() const;
+	bool				empty() const;
+	Membership const	&operator[](size_t i) const;
+
+private:
+	MemberList(MemberList const &other);
+	MemberList	&operator=(MemberList const &other);
+
+	std::vector<Membership *>	_members;
+	PointerMap					_index;
+};
+
+#endif
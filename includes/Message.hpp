@@ -0,0 +1,44 @@
+#ifndef _MESSAGE_HPP
+# define _MESSAGE_HPP
+
+# include <string>
+# include <cstddef>
+# include <string.h>
+
+# define MESSAGE_PARAMS_MAX 15
+# define MESSAGE_LENGTH_MAX 512
+
+/* Bytes of a line, not owned: valid as long as the line is */
+struct Span {
+	Span() : data(""), length(0) {}
+	Span(const char *begin, const char *end) : data(begin), length(end - begin) {}
+
+	std::string	str() const { return (std::string(data, length)); }
+	bool		empty() const { return (length == 0); }
+	bool		operator==(const char *s) const { return (strlen(s) == length && !memcmp(data, s, length)); }
+
+	const char	*data;
+	size_t		length;
+};
+
+/*
+Parsed IRC line (RFC 1459 / RFC 2812):
+	[':' prefix SPACE] command *( SPACE middle ) [SPACE ':' trailing]
+The trailing part is also the last of params, as the RFC counts it,
+and after 14 middles the rest of the line is the trailing one.
+Every span points into the parsed line, nothing is copied.
+*/
+struct Message {
+	Message() : paramCount(0), hasTrailing(false) {}
+
+	Span	prefix;
+	Span	command;
+	Span	params[MESSAGE_PARAMS_MAX];
+	size_t	paramCount;
+	Span	trailing;
+	bool	hasTrailing;
+};
+
+bool	parseMessage(const char *line, size_t length, Message &message);
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef _METRICS_HPP
+# define _METRICS_HPP
+
+# include <string>
+# include <vector>
+# include <cstddef>
+# include <pthread.h>
+
+# define METRICS_POLL_TIMEOUT 200
+
+# define LATENCY_SUB_BITS 4
+# define LATENCY_EXPONENT_MAX 39
+# define LATENCY_BUCKETS ((LATENCY_EXPONENT_MAX - LATENCY_SUB_BITS + 2) << LATENCY_SUB_BITS)
+
+/*
+HDR-style histogram of durations in nanoseconds: each power of two
+is split in 2^LATENCY_SUB_BITS linear buckets, so a quantile is known
+within 1/16th of its value from 1ns up to 2^(LATENCY_EXPONENT_MAX+1)ns.
+Recording is a few relaxed atomic adds, cheap enough for every command.
+*/
+class LatencyHistogram {
+
+public:
+	LatencyHistogram();
+
+	void			record(unsigned long nanoseconds);
+	unsigned long	quantile(double q) const;
+	unsigned long	count() const { return (__atomic_load_n(&_count, __ATOMIC_RELAXED)); }
+	unsigned long	sum() const { return (__atomic_load_n(&_sum, __ATOMIC_RELAXED)); }
+
+private:
+	unsigned long	_buckets[LATENCY_BUCKETS];
+	unsigned long	_count;
+	unsigned long	_sum;
+};
+
+/*
+Base of every metric: registered by its constructor in the registry
+that renderMetrics() walks, in the Prometheus text format.
+Values are atomics updated with relaxed ordering, from any thread.
+*/
+class Metric {
+
+public:
+	Metric(const char *name, const char *help);
+	virtual ~Metric();
+
+	virtual void	render(std::string &out) const = 0;
+
+protected:
+	void	header(std::string &out, const char *type) const;
+	void	sample(std::string &out, const char *suffix, const char *labels, unsigned long value) const;
+	void	summary(std::string &out, const char *labels, LatencyHistogram const &latency) const;
+
+	const char	*_name;
+	const char	*_help;
+
+private:
+	Metric(Metric const &other);
+	Metric	&operator=(Metric const &other);
+};
+
+/* Value that only goes up */
+class Counter : public Metric {
+
+public:
+	Counter(const char *name, const char *help);
+
+	void			add(unsigned long n = 1) { __atomic_add_fetch(&_value, n, __ATOMIC_RELAXED); }
+	unsigned long	value() const { return (__atomic_load_n(&_value, __ATOMIC_RELAXED)); }
+	virtual void	render(std::string &out) const;
+
+private:
+	unsigned long	_value;
+};
+
+/* Value that goes up and down */
+class Gauge : public Metric {
+
+public:
+	Gauge(const char *name, const char *help);
+
+	void			add(long n) { __atomic_add_fetch(&_value, n, __ATOMIC_RELAXED); }
+	void			set(long n) { __atomic_store_n(&_value, n, __ATOMIC_RELAXED); }
+	long			value() const { return (__atomic_load_n(&_value, __ATOMIC_RELAXED)); }
+	virtual void	render(std::string &out) const;
+
+private:
+	long	_value;
+};
+
+/* Distribution of integer observations over fixed upper bounds */
+class Histogram : public Metric {
+
+public:
+	Histogram(const char *name, const char *help, unsigned long const *bounds, size_t count);
+	virtual ~Histogram();
+
+	void			observe(unsigned long value);
+	virtual void	render(std::string &out) const;
+
+private:
+	unsigned long const	*_bounds;
+	size_t				_count;
+	unsigned long		*_buckets;
+	unsigned long		_sum;
+};
+
+/* Durations rendered as p50, p99 and p999 in seconds */
+class Summary : public Metric {
+
+public:
+	Summary(const char *name, const char *help);
+
+	void			record(unsigned long nanoseconds) { _latency.record(nanoseconds); }
+	virtual void	render(std::string &out) const;
+
+private:
+	LatencyHistogram	_latency;
+};
+
+std::string	renderMetrics();
+
+/*
+Serves renderMetrics() on a Unix socket, from a thread of its own:
+each connection gets an HTTP/1.0 response and is closed, so both
+curl --unix-socket and a plain socket client can scrape it.
+*/
+class MetricsExporter {
+
+public:
+	static void	start(std::string const &path);
+	static void	stop();
+
+private:
+	static void	*serve(void *arg);
+
+	static int			_fd;
+	static bool			_stop;
+	static pthread_t	_thread;
+	static std::string	_path;
+};
+
+extern Counter		g_connectionsTotal;
+extern Gauge		g_users;
+extern Gauge		g_channels;
+extern Counter		g_commandsTotal;
+extern Counter		g_unknownCommandsTotal;
+extern Counter		g_bytesReceivedTotal;
+extern Counter		g_bytesSentTotal;
+extern Counter		g_messagesQueuedTotal;
+extern Counter		g_sendFailuresTotal;
+extern Histogram	g_fanoutRecipients;
+extern Gauge		g_loopLag;
+extern Summary		g_loopLagSeconds;
+
+#endif
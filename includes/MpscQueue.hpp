@@ -0,0 +1,67 @@
+#ifndef _MPSCQUEUE_HPP
+# define _MPSCQUEUE_HPP
+
+# include <cstddef>
+
+/*
+Unbounded lock-free queue with many producers and a single consumer,
+intrusive: T must have a "T *next" member (Vyukov's algorithm).
+push may be called from any thread, pop only from the consumer thread.
+pop can miss a node whose push is still in progress, producers
+must wake the consumer after pushing so that it looks again.
+*/
+template <typename T>
+class MpscQueue {
+
+public:
+	MpscQueue() : _head(&_stub), _tail(&_stub) { _stub.next = NULL; }
+
+	void	push(T *node)
+	{
+		T	*prev;
+
+		__atomic_store_n(&node->next, (T *)NULL, __ATOMIC_RELAXED);
+		prev = __atomic_exchange_n(&_head, node, __ATOMIC_ACQ_REL);
+		__atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+	}
+
+	T	*pop()
+	{
+		T	*tail = _tail;
+		T	*next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+		if (tail == &_stub) {
+			if (!next)
+				return (NULL);
+			_tail = next;
+			tail = next;
+			next = __atomic_load_n(&next->next, __ATOMIC_ACQUIRE);
+		}
+
+		if (next) {
+			_tail = next;
+			return (tail);
+		}
+
+		if (tail != __atomic_load_n(&_head, __ATOMIC_ACQUIRE))
+			return (NULL);
+
+		push(&_stub);
+		next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+		if (next) {
+			_tail = next;
+			return (tail);
+		}
+		return (NULL);
+	}
+
+private:
+	MpscQueue(MpscQueue const &src);
+	MpscQueue	&operator=(MpscQueue const &src);
+
+	T	*_head;
+	T	*_tail;
+	T	_stub;
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef _OBJECTPOOL_HPP
+# define _OBJECTPOOL_HPP
+
+# include <vector>
+# include <cstddef>
+
+/*
+Storage for objects of one size, carved from slabs of a fixed number
+of objects and recycled through a free list, so that connection churn
+reuses the same memory instead of fragmenting the heap.
+Slabs are only given back when the pool is destroyed.
+Not thread-safe: used by the server thread only.
+*/
+class ObjectPool {
+
+public:
+	ObjectPool(size_t objectSize, size_t objectsPerSlab);
+	~ObjectPool();
+
+	void	*allocate(size_t size);
+	void	release(void *ptr, size_t size);
+
+	size_t	capacity() const;
+	size_t	used() const;
+
+private:
+	ObjectPool(ObjectPool const &other);
+	ObjectPool	&operator=(ObjectPool const &other);
+
+	void	grow();
+
+	size_t				_objectSize;
+	size_t				_objectsPerSlab;
+	void				*_freeList;
+	size_t				_used;
+	std::vector<char *>	_slabs;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef _POINTERMAP_HPP
+# define _POINTERMAP_HPP
+
+# include <vector>
+# include <cstddef>
+# include <stdint.h>
+
+/*
+Open-addressing hash table from pointers to indexes:
+linear probing in a power-of-two array, kept at most half full,
+with backward-shift deletion so that no tombstone is ever left.
+Used as a set when the value doesn't matter.
+*/
+class PointerMap {
+
+public:
+	PointerMap();
+	~PointerMap();
+
+	void	insert(const void *key, size_t value);
+	bool	find(const void *key, size_t &value) const;
+	bool	contains(const void *key) const;
+	bool	erase(const void *key);
+	void	clear();
+	size_t	size() const;
+
+private:
+	struct Slot {
+		const void	*key;
+		size_t		value;
+	};
+
+	size_t	slotOf(const void *key) const;
+	void	grow();
+
+	std::vector<Slot>	_slots;
+	size_t				_size;
+};
+
+#endif
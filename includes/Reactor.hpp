@@ -0,0 +1,79 @@
+#ifndef _REACTOR_HPP
+# define _REACTOR_HPP
+
+# include <ctime>
+
+# include "Config.hpp"
+# include "Utils.hpp"
+
+# define SHED_WARNING_INTERVAL 1000000000UL
+
+class Server;
+class User;
+
+/*
+Event-loop backend of the server.
+A reactor owns the sockets I/O: it accepts clients, reads their
+data and writes their outbound queues, calling back the server
+through createUser, handleInput and removeUser.
+*/
+class Reactor {
+
+public:
+	Reactor() : _wakeTime(0) {}
+	virtual ~Reactor() {}
+
+	//Registers the listening socket, must be called once before poll
+	virtual void	start(int socketServer) = 0;
+
+	//Waits for one batch of events and dispatches it, returns -1 on error
+	virtual int		poll() = 0;
+
+	//Starts and stops watching the socket of a user, removal closes the socket
+	virtual int		addConnection(User &user) = 0;
+	virtual void	removeConnection(User &user) = 0;
+
+	//Writes the outbound queue of a user, returns 1 on error
+	virtual int		flush(User &user) = 0;
+
+	//Clock of the flood penalties, in seconds: the wall clock, unless the events are replayed
+	virtual time_t	now() const { return (time(NULL)); }
+
+	//Returns when the last poll woke up with events, then forgets it, 0 if it did not
+	unsigned long	takeWakeTime() { unsigned long time = _wakeTime; _wakeTime = 0; return (time); }
+
+	static Reactor	*create(Server &server, Config const &config);
+
+protected:
+	//Called by poll as soon as its wait returns, for the loop lag
+	void	woke() { _wakeTime = monotonicNanoseconds(); }
+
+private:
+	unsigned long	_wakeTime;
+};
+
+/*
+Descriptor held back for when the process runs out of them: a pending
+connection can't be accepted then, and the listener keeps reporting it.
+shed frees the reserve, accepts and closes the connection, then takes
+the reserve back. The refused connections are logged once a second.
+*/
+class AcceptReserve {
+
+public:
+	AcceptReserve();
+	~AcceptReserve();
+
+	//Refuses one pending connection, returns whether there was one
+	bool	shed(int socketServer);
+
+private:
+	AcceptReserve(AcceptReserve const &src);
+	AcceptReserve	&operator=(AcceptReserve const &src);
+
+	int				_fd;
+	unsigned long	_refused;
+	unsigned long	_lastWarning;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef _REPLAYREACTOR_HPP
+# define _REPLAYREACTOR_HPP
+
+# include "Reactor.hpp"
+# include "Capture.hpp"
+
+# define REPLAY_BATCH 64
+
+/*
+In-memory backend driving the server with a capture file:
+connections, reads and closes are replayed as recorded, at full
+speed or at the recorded pacing, and the replies go to a null sink.
+The server stops at the end of the capture. The flood penalties
+follow the recorded time, so a replay at full speed is not a flood.
+*/
+class ReplayReactor : public Reactor {
+
+public:
+	ReplayReactor(Server &server, Config const &config);
+	virtual ~ReplayReactor();
+
+	virtual void	start(int socketServer);
+	virtual int		poll();
+	virtual int		addConnection(User &user);
+	virtual void	removeConnection(User &user);
+	virtual int		flush(User &user);
+	virtual time_t	now() const;
+
+private:
+	ReplayReactor();
+	ReplayReactor(ReplayReactor const &src);
+	ReplayReactor	&operator=(ReplayReactor const &src);
+
+	void	replay(CaptureRecord const &record);
+	void	finish();
+
+	Server			&_server;
+	CaptureReader	_reader;
+	bool			_paced;
+	CaptureRecord	_record;
+	bool			_hasRecord;
+	uint64_t		_replayTime;
+	unsigned long	_start;
+	unsigned long	_records;
+	unsigned long	_bytesIn;
+	unsigned long	_bytesOut;
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef _REPLY_HPP
+# define _REPLY_HPP
+
+# include <string>
+# include <cstddef>
+
+# include "SharedBuffer.hpp"
+# include "Message.hpp"
+
+/*
+Reply formatted in place in the buffer it is sent from: each % of the
+template is replaced by the next arg(), the text between them is copied
+as is, and buffer() ends the line with CRLF. The only allocation is the
+slab block of the SharedBuffer, with no intermediate std::string.
+A reply is cut at MESSAGE_LENGTH_MAX bytes, CRLF included.
+*/
+class Reply {
+
+public:
+	explicit Reply(const char *format);
+	~Reply();
+
+	Reply			&arg(const char *data, size_t length);
+	Reply			&arg(const char *str);
+	Reply			&arg(std::string const &str);
+	Reply			&arg(Span const &span);
+	SharedBuffer	buffer();
+
+private:
+	Reply(Reply const &other);
+	Reply	&operator=(Reply const &other);
+
+	void	write(const char *data, size_t length);
+	void	literal();
+
+	const char				*_format;
+	SharedBuffer::Block		*_block;
+	char					*_data;
+	size_t					_length;
+};
+
+#endif
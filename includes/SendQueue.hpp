@@ -0,0 +1,47 @@
+#ifndef _SENDQUEUE_HPP
+# define _SENDQUEUE_HPP
+
+# include <string>
+# include <deque>
+# include <cerrno>
+# include <string.h>
+# include <sys/types.h>
+# include <sys/socket.h>
+# include <sys/uio.h>
+
+# include "SharedBuffer.hpp"
+
+# define SEND_IOV_MAX 64
+
+/*
+Outbound bytes of a connection, kept as the list of queued
+messages plus how much of the first one was already written.
+The messages are shared buffers, a broadcast is queued by reference.
+The bytes left to write are counted for the --sendq limit.
+*/
+class SendQueue {
+
+public:
+	SendQueue();
+	~SendQueue();
+
+	void	push(SharedBuffer const &message);
+	int		send(int socket);
+	size_t	gather(struct iovec *iov, size_t max) const;
+	void	consume(size_t bytes);
+	void	append(SendQueue &other);
+	void	swap(SendQueue &other);
+	void	clear();
+	bool	empty() const;
+	size_t	size() const;
+
+	const std::deque<SharedBuffer>	&getChunks() const;
+	const size_t					&getOffset() const;
+
+private:
+	std::deque<SharedBuffer>	_chunks;
+	size_t						_offset;
+	size_t						_size;
+};
+
+#endif
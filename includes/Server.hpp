@@ -15,14 +15,25 @@
 # include <netinet/in.h>
 # include <arpa/inet.h>
 # include <fcntl.h>
-# include <sys/epoll.h>
 # include <vector>
 # include <map>
+# include <tr1/unordered_map>
 # include <algorithm>
 # include <ctime>
+# include <iomanip>
 #include <signal.h>
 
 # include "Format.hpp"
+# include "Config.hpp"
+# include "Allocation.hpp"
+# include "Logger.hpp"
+# include "Metrics.hpp"
+# include "Reactor.hpp"
+# include "Capture.hpp"
+# include "SharedBuffer.hpp"
+# include "Reply.hpp"
+# include "Message.hpp"
+# include "MemberList.hpp"
 # include "User.hpp"
 # include "Channel.hpp"
 
@@ -30,10 +41,12 @@
 # define MODIFY 1
 # define EVENTS_MAX 8
 # define BUFFER_SIZE 4096
+# define RECV_BUDGET (16 * BUFFER_SIZE)
 # define SERVER_NAME ":irc.serv.M.M.L "
 # define SERVER_DESCRIPTION "very cool server"
 
-# define CMD_PRIVMSG(sender, target, message)						((std::string)sender + " PRIVMSG "  + (target.empty() ? ":" : target + " :") + message + "\r\n");
+/* Macros taking parameters build a std::string, the others are Reply templates */
+
 # define CMD_NICK(sender, newNick)									((std::string)sender + " NICK :" + newNick + "\r\n");
 # define CMD_NOTICE_TARGET(sender, message, target)					((std::string)sender + " NOTICE " + (target.empty() ? "" : target + " ") + message + "\r\n");
 # define CMD_PING(target, targetNick)								((std::string)SERVER_NAME + "PONG " + target + " :" + targetNick + "\r\n");
@@ -43,11 +56,21 @@
 # define RPL_YOURHOST(nickName)										((std::string)SERVER_NAME + "003 " + nickName + " :" + "This server was created Tue Mars 23 2024 at 22:15:05 CEST" + "\r\n");
 # define RPL_MYINFO(nickName)										((std::string)SERVER_NAME + "004 " + nickName + " " + SERVER_NAME + "\r\n");
 # define RPL_USERHOST(nickName, infoTarget)							((std::string)SERVER_NAME + "302 " + nickName + " :" + infoTarget + "\r\n");
+# define CMD_PRIVMSG												"% PRIVMSG % :%"
+# define RPL_ENDOFSTATS												SERVER_NAME "219 % % :End of /STATS report"
+# define RPL_STATSDEBUG												SERVER_NAME "249 % :%"
+# define RPL_YOUREOPER												SERVER_NAME "381 % :You are now an IRC operator"
 
 # define ERR_NOSUCHNICK(nickName, attemptedTarget)					((std::string)SERVER_NAME + "401 " + nickName + " " + attemptedTarget + " :No such nick/channel" + "\r\n");
 # define ERR_NOSUCHCHAN(nickName, attemptedTarget)					((std::string)SERVER_NAME + "403 " + nickName + " " + attemptedTarget + " :No such channel" + "\r\n");
+# define ERR_CANNOTSENDTOCHAN										SERVER_NAME "404 % % :Cannot send to channel"
 # define ERR_NICKNAMEINUSE(userCurrentNick, attemptedNick)			((std::string)SERVER_NAME + "433 " + userCurrentNick + " " + attemptedNick + " :Nickname is already in use." + "\r\n");
-# define ERR_NEEDMOREPARAMS(nickName, command)						((std::string)SERVER_NAME + "461 " + nickName + " " + command + " :Not enough parameters" + "\r\n");
+# define ERR_UNKNOWNCOMMAND											SERVER_NAME "421 % % :Unknown command"
+# define ERR_NOTREGISTERED											SERVER_NAME "451 % :You have not registered"
+# define ERR_NEEDMOREPARAMS											SERVER_NAME "461 % % :Not enough parameters"
+# define ERR_ALREADYREGISTRED										SERVER_NAME "462 % :You may not reregister"
+# define ERR_PASSWDMISMATCH											SERVER_NAME "464 % :Password incorrect"
+# define ERR_NOPRIVILEGES											SERVER_NAME "481 % :Permission Denied- You're not an IRC operator"
 
 class User;
 class Channel;
@@ -60,78 +83,101 @@ class Server {
 public:
 
 	//CONSTRUCTORS & DESTRUCTORS
-	Server(std::string const &port, std::string const &password);
+	Server(std::string const &port, std::string const &password, Config const &config);
 	~Server(void);
 
+	//SOCKETS
+	int		openSocket(bool reusePort) const;
+
 	//EVENTS AND COMMANDS MANAGEMENT
 	void		run();
-	void		handleEvents(int fd, struct epoll_event event);
-	std::string	receiveData(int sockfd) const;
-	int			getCommands(User &user, std::string & buffer) const;
-	void		parseCommands(std::string &s, std::string &cmd, std::vector<std::string> &args, std::string & mess) const;
-	void		execCommand(User &user);
+	void		setReactor(Reactor *reactor);
+	void		handleInput(User &user, bool closed);
+	void		execCommand(User &user, const char *line, size_t length);
+	void		flushPendingWrites();
+	void		recordLoopLag();
 	void		quit();
 
 	//USERS MANAGEMENT
 	int		checkPassword(std::string const &password) const;
-	int		createUser();
+	int		createUser(int sockfd, struct sockaddr_in const &addr);
 	void	removeUser(User &user, std::string const &reason);
 	User	*findUserBySocket(const int sockfd) const;
 	User	*findUserByNickname(const std::string &targetNickname, User const &user) const;
 	User	*findUserByNickname(const std::string &targetNickname) const;
+	void	setNickname(User &user, std::string const &nickname);
 
 	//CHANNEL MANAGEMENT
 	Channel	*createChannel(User &user, std::string const &channelName);
-	Channel	*findChannelByName(std::string const &name, User const &user) const;
+	Channel	*findChannel(std::string const &name) const;
 	void	removeChannel(Channel *channel);
 
 	//MESSAGES MANAGEMENT
-	int			sendMessageToUser(const User &user, const std::string message) const;
-	void		sendMessageToALL(const User &user, std::map<User *, bool> users, std::string message, bool ToMe = true) const;
-	void		sendMessage(const User &user, const std::string target, const std::string message) const;
+	int			sendMessageToUser(const User &user, std::string const &message) const;
+	int			sendMessageToUser(const User &user, SharedBuffer const &message) const;
+	void		sendMessageToALL(const User &user, MemberList const &users, std::string const &message, bool ToMe = true) const;
+	void		sendMessageToALL(const User &user, MemberList const &users, SharedBuffer const &message, bool ToMe = true) const;
+	void		sendMessageToNeighbours(User &user, std::string const &message, bool toMe = true);
+	void		sendMessage(const User &user, std::string const &target, SharedBuffer const &message) const;
 	
 
 	//COMMANDS
 		//USER AND CONNECTION RELATED COMMANDS
 		bool	userIsConnected(User const &user);
 		void	checkConnection(User &user);
-		bool	password(User &user, std::vector<std::string> const &args);
-		void	userName(User &user, std::vector<std::string> const &args);
-		void	nickName(User &user, std::vector<std::string> const &args);
+		void	password(User &user, std::vector<std::string> const &args, std::string const &message);
+		void	userName(User &user, std::vector<std::string> const &args, std::string const &message);
+		void	nickName(User &user, std::vector<std::string> const &args, std::string const &message);
+		void	userQuit(User &user, std::vector<std::string> const &args, std::string const &message);
 		void	welcome(User &user) const;
-		void    pong(const User &user, std::vector<std::string> const &args) const;
-		void	whoIs(User &requestingUser, std::vector<std::string> const &args) const;
-		void	privmsg(const User &user, std::vector<std::string> const &args, std::string const &message) const;
-		void	notice(User &user, std::vector<std::string> const &args);
-		void	userHost(User &user, std::vector<std::string> const &args);
+		void    pong(User &user, std::vector<std::string> const &args, std::string const &message);
+		void	whoIs(User &requestingUser, std::vector<std::string> const &args, std::string const &message);
+		void	privmsg(User &user, std::vector<std::string> const &args, std::string const &message);
+		void	notice(User &user, std::vector<std::string> const &args, std::string const &message);
+		void	userHost(User &user, std::vector<std::string> const &args, std::string const &message);
+		void	oper(User &user, std::vector<std::string> const &args, std::string const &message);
+		void	stats(User &user, std::vector<std::string> const &args, std::string const &message);
 		
 		//CHANNEL COMMANDS
-		void	joinChannel(User &user, std::vector<std::string> const &args);
-		void	inviteChannel(User &invitingUser, std::vector<std::string> const &args);
+		void	joinChannel(User &user, std::vector<std::string> const &args, std::string const &message);
+		void	inviteChannel(User &invitingUser, std::vector<std::string> const &args, std::string const &message);
 		void	partChannel(User &user, std::vector<std::string> const &args, std::string const &reason);
 		void	kickChannel(User &kicker, std::vector<std::string> const &args, std::string const &reason);
 		void	topicChannel(User &user, std::vector<std::string> const &args, std::string const &topic);
-		void	modeChannel(User &user, std::vector<std::string> const &args);
-		void	who(User &user, std::vector<std::string> const &args) const;
+		void	modeChannel(User &user, std::vector<std::string> const &args, std::string const &message);
+		void	who(User &user, std::vector<std::string> const &args, std::string const &message);
+		void	names(User &user, std::vector<std::string> const &args, std::string const &message);
 
-	//EXCEPTIONS
-	class noSuchChannel : public std::exception {
-	private:
-		std::string message;
+	//COMMAND TABLE
+	typedef void	(Server::*Handler)(User &user, std::vector<std::string> const &args, std::string const &message);
 
-	public:
-		noSuchChannel(const std::string& nick, const std::string& target) {
-			std::stringstream ss;
-			ss << ERR_NOSUCHCHAN(nick, target);
-			message = ss.str();
-		}
+	enum Registration {
+		REGISTRATION_ANY,
+		REGISTRATION_REQUIRED,
+		REGISTRATION_FORBIDDEN
+	};
 
-		virtual const char* what() const throw() {
-			return message.c_str();
-		}
-		virtual ~noSuchChannel() throw() {}
+	struct Command {
+		const char		*name;
+		Handler			handler;
+		size_t			minParams;
+		Registration	registration;
+		unsigned int	cost;
 	};
 
+	static Command const	*findCommand(Span const &name);
+	static Command const	*getCommand(size_t index);
+
+	//Calls of a command, the heap allocations made while running them and their durations
+	struct CommandStats {
+		unsigned long		calls;
+		unsigned long		allocations;
+		LatencyHistogram	latency;
+	};
+
+	void	printAllocationStats() const;
+
+	//EXCEPTIONS
 	class noSuchNick : public std::exception {
 	private:
 		std::string message;
@@ -149,34 +195,28 @@ public:
 		virtual ~noSuchNick() throw() {}
 	};
 
-	class needMoreParams : public std::exception {
-	private:
-		std::string message;
-
-	public:
-		needMoreParams(const std::string& nick, const std::string& command) {
-			std::stringstream ss;
-			ss << ERR_NEEDMOREPARAMS(nick, command);
-			message = ss.str();
-		}
-
-		virtual const char* what() const throw() {
-			return message.c_str();
-		}
-		virtual ~needMoreParams() throw() {}
-	};
-
 private:
 	
 	Server(void);
 
+	void	forgetNickname(User &user);
+
 	std::string				_port;
 	std::string				_password;
+	Config					_config;
 	int 					_socketServer;
 
-	std::vector<User *>		_users;
-	std::vector<Channel *>	_channels;
-	int						_epollfd;
+	std::vector<User *>		_connections;
+	std::tr1::unordered_map<std::string, User *>	_nicknames;
+	std::tr1::unordered_map<std::string, Channel *>	_channels;
+	Reactor					*_reactor;
+
+	mutable std::vector<User *>	_pendingFlush;
+	std::vector<User *>			_closingUsers;
+
+	std::vector<std::string>	_args;
+	std::string					_trailing;
+	unsigned long				_fanoutEpoch;
 };
 
 #endif
\ No newline at end of file
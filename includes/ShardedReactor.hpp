@@ -0,0 +1,119 @@
+#ifndef _SHARDEDREACTOR_HPP
+# define _SHARDEDREACTOR_HPP
+
+# include <pthread.h>
+# include <sys/epoll.h>
+# include <netinet/in.h>
+# include <vector>
+# include <string>
+
+# include "Reactor.hpp"
+# include "SendQueue.hpp"
+# include "MpscQueue.hpp"
+
+/*
+Multi-reactor backend: N shard threads, each with its own SO_REUSEPORT
+listening socket and epoll instance, own the sockets they accept and do
+all their syscalls. Users and channels stay on the server thread, which
+receives the input of every shard and hands outbound queues back to the
+shard owning the recipient, both through lock-free queues. Messages
+go back to the thread which created them once handled, to be reused.
+A shard closes a socket only when the server asks for it, so a socket
+number is never reused while the server still knows the old user.
+*/
+class ShardedReactor : public Reactor {
+
+public:
+	ShardedReactor(Server &server, Config const &config);
+	virtual ~ShardedReactor();
+
+	virtual void	start(int socketServer);
+	virtual int		poll();
+	virtual int		addConnection(User &user);
+	virtual void	removeConnection(User &user);
+	virtual int		flush(User &user);
+
+private:
+	struct Shard;
+
+	//Unit of work exchanged between the server thread and the shards
+	struct Message {
+		enum Type {
+			ACCEPT,
+			DATA,
+			CLOSED,
+			SENDQ,
+			SEND,
+			CLOSE
+		};
+
+		Message();
+
+		Message		*next;
+		Type		type;
+		int			fd;
+		Shard		*shard;
+		sockaddr_in	addr;
+		std::string	data;
+		SendQueue	queue;
+	};
+
+	//Socket state owned by a shard thread
+	struct Connection {
+		Connection();
+
+		SendQueue	queue;
+		bool		writeArmed;
+		bool		closed;
+	};
+
+	struct Shard {
+		Shard();
+
+		ShardedReactor				*reactor;
+		pthread_t					thread;
+		bool						running;
+		bool						stop;
+		bool						dirty;
+		int							socketServer;
+		int							epollfd;
+		int							wakefd;
+		MpscQueue<Message>			inbox;
+		MpscQueue<Message>			spare;
+		std::vector<Connection *>	connections;
+		AcceptReserve				reserve;
+	};
+
+	ShardedReactor();
+	ShardedReactor(ShardedReactor const &src);
+	ShardedReactor	&operator=(ShardedReactor const &src);
+
+	static Message	*acquire(MpscQueue<Message> &spare);
+	static void		release(MpscQueue<Message> &spare);
+	static void	*shardMain(void *arg);
+	void		runShard(Shard &shard);
+	bool		acceptConnection(Shard &shard);
+	bool		handleEvents(Shard &shard, int fd, uint32_t events);
+	int			receiveData(Shard &shard, int fd, std::string &data);
+	int			flushConnection(Shard &shard, int fd);
+	bool		handleInbox(Shard &shard);
+	void		post(Shard &shard, Message *message);
+	void		dispatch(Message &message);
+	void		send(Shard &shard, Message *message);
+	void		stopShard(Shard &shard);
+
+	Server					&_server;
+	bool					_edgeTriggered;
+	size_t					_count;
+	size_t					_backlog;
+	size_t					_acceptBudget;
+	size_t					_sendqLimit;
+	std::vector<Shard *>	_shards;
+	std::vector<Shard *>	_owners;
+	MpscQueue<Message>		_inbox;
+	MpscQueue<Message>		_spare;
+	int						_epollfd;
+	int						_wakefd;
+};
+
+#endif
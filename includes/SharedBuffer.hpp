@@ -0,0 +1,51 @@
+#ifndef _SHAREDBUFFER_HPP
+# define _SHAREDBUFFER_HPP
+
+# include <string>
+# include <cstddef>
+
+# define BUFFER_SLAB_PAYLOAD 512
+# define BUFFER_SLAB_BLOCKS 64
+
+/*
+Immutable message serialized once and shared by every outbound
+queue it is sent to, copying a SharedBuffer only takes a reference.
+Messages up to BUFFER_SLAB_PAYLOAD bytes (a whole IRC line) come from
+a slab allocator, longer ones from the heap.
+References may be dropped from any thread, the reactor threads
+release the buffers they have written.
+*/
+class SharedBuffer {
+
+public:
+	SharedBuffer();
+	explicit SharedBuffer(std::string const &content);
+	SharedBuffer(SharedBuffer const &src);
+	~SharedBuffer();
+
+	SharedBuffer	&operator=(SharedBuffer const &src);
+
+	const char	*data() const;
+	size_t		length() const;
+	bool		empty() const;
+
+private:
+	friend class Reply;
+
+	//Header of a block, the bytes of the message follow it
+	struct Block {
+		Block	*next;
+		int		refs;
+		bool	slab;
+		size_t	length;
+	};
+
+	static Block	*allocate(size_t length);
+	static void		release(Block *block);
+
+	explicit SharedBuffer(Block *block);
+
+	Block	*_block;
+};
+
+#endif
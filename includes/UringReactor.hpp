@@ -0,0 +1,116 @@
+#ifndef _URINGREACTOR_HPP
+# define _URINGREACTOR_HPP
+
+# include <linux/io_uring.h>
+# include <stdint.h>
+# include <string>
+# include <deque>
+# include <vector>
+
+# include "Reactor.hpp"
+# include "SendQueue.hpp"
+
+# define URING_ENTRIES 256
+# define URING_BUFFERS 1024
+# define URING_BUFFER_GROUP 0
+
+/*
+Completion-based backend built on io_uring through raw syscalls:
+- a multishot accept on the listening socket,
+- a multishot recv per client, reading into provided buffers,
+  or a one-shot recv into its own buffer while they ran out,
+- outbound queues written by one sendmsg per socket at a time.
+Submissions queued while handling a batch go to the kernel
+with the next wait, in a single io_uring_enter call.
+Only the opcodes are probed up front: a kernel which rejects the
+multishot flags or cancelling by socket with -EINVAL makes the
+reactor go on with one-shot accepts and recvs, or cancel each request.
+*/
+class UringReactor : public Reactor {
+
+public:
+	UringReactor(Server &server, Config const &config);
+	virtual ~UringReactor();
+
+	virtual void	start(int socketServer);
+	virtual int		poll();
+	virtual int		addConnection(User &user);
+	virtual void	removeConnection(User &user);
+	virtual int		flush(User &user);
+
+private:
+	enum Operation {
+		OP_ACCEPT,
+		OP_RECV,
+		OP_SEND,
+		OP_PROVIDE,
+		OP_CANCEL
+	};
+
+	//Per socket state, kept until every request on the socket completed
+	struct Connection {
+		Connection();
+
+		User					*user;
+		bool					recvArmed;
+		bool					sendFailed;
+		bool					sendInflight;
+		SendQueue				orphanQueue;
+		struct msghdr			msg;
+		struct iovec			iov[SEND_IOV_MAX];
+		std::vector<char>		buffer;
+	};
+
+	UringReactor();
+	UringReactor(UringReactor const &src);
+	UringReactor	&operator=(UringReactor const &src);
+
+	void				release();
+	bool				supportsOperations() const;
+	struct io_uring_sqe	*getSqe(Operation op, int fd);
+	int					submit(unsigned waitCount);
+	void				handleCompletion(struct io_uring_cqe const &cqe);
+	void				handleAccept(struct io_uring_cqe const &cqe);
+	void				handleRecv(int fd, struct io_uring_cqe const &cqe);
+	void				handleSend(int fd, struct io_uring_cqe const &cqe);
+	void				handleCancel(int fd, struct io_uring_cqe const &cqe);
+	void				armAccept();
+	void				armRecv(int fd);
+	void				armRecvOnce(int fd);
+	void				provideBuffers(unsigned short bid, unsigned count);
+	void				cancelRequests(int fd);
+	void				cancelRequest(int fd, Operation op);
+	void				closeIfIdle(int fd);
+
+	Server					&_server;
+	int						_ringfd;
+	int						_socketServer;
+	unsigned				_toSubmit;
+	bool					_multishotAccept;
+	bool					_multishotRecv;
+	bool					_cancelByFd;
+	bool					_acceptPaused;
+	AcceptReserve			_reserve;
+
+	void					*_sqRing;
+	size_t					_sqRingSize;
+	void					*_cqRing;
+	size_t					_cqRingSize;
+	struct io_uring_sqe		*_sqes;
+	size_t					_sqesSize;
+
+	unsigned				*_sqHead;
+	unsigned				*_sqTail;
+	unsigned				_sqMask;
+	unsigned				_sqEntries;
+	unsigned				*_sqArray;
+	unsigned				*_cqHead;
+	unsigned				*_cqTail;
+	unsigned				_cqMask;
+	struct io_uring_cqe		*_cqes;
+
+	char					*_buffers;
+	std::vector<Connection *>	_connections;
+};
+
+#endif
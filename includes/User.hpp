@@ -4,11 +4,17 @@
 # include <string>
 # include <iostream>
 # include <deque>
+# include <ctime>
 # include <sys/socket.h>
 # include <netinet/in.h>
 
 # include "Server.hpp"
 # include "Channel.hpp"
+# include "SendQueue.hpp"
+# include "InputBuffer.hpp"
+# include "ObjectPool.hpp"
+
+# define USER_POOL_SLAB 64
 
 #define RPL_WHOISUSER(requestingUserNick, inquiredUserNick, id, realHost, realName)	((std::string)SERVER_NAME + "311 " + requestingUserNick + " " + inquiredUserNick + " " + id + " " + realHost + " * :" + realName + "\r\n");
 #define RPL_WHOISSERVER(requestingUserNick, inquiredUserNick)						((std::string)SERVER_NAME + "312 " + requestingUserNick + " " + inquiredUserNick + " " + SERVER_NAME + ":" + SERVER_DESCRIPTION + "\r\n");
@@ -27,39 +33,60 @@ public:
 	User(std::string const & username, std::string const & nickname);
 	~User(void);
 
+	static void	*operator new(size_t size);
+	static void	operator delete(void *ptr, size_t size);
+
 	//SETTERS,  GETTERS	AND UPDATERS
 	void	setUsername(std::string const &username);
 	void	setNickname(std::string const &nickname);
 	void	setInet(std::string const &inet);
-	void	setCommands(std::deque<std::string> const &commands);
-	void	setBuffer(std::string const &buffer);
+	void	appendBuffer(const char *data, size_t length);
 	void	setSocket(int const &socket);
 	void	setAddr(sockaddr_in const &addr);
 	void	setStatus(bool const &connected);
 	void	setSent(bool const &connected);
+	void	setWriteArmed(bool const &armed);
+	void	setFlushPending(bool const &pending);
+	void	setClosing(bool const &closing);
+	void	setOperator(bool const &op);
+	void	setFloodTime(time_t const &floodTime);
+	void	setFanoutMark(unsigned long const &mark);
 	
 	const std::string& 				getUsername() const;
 	const std::string&				getNickname() const;
 	const std::string&				getInet() const;
-	const std::string&				getBuffer() const;
 	const int&						getSocket() const;
 	const struct sockaddr_in&		getAddr() const;
-	const std::deque<std::string>&	getCommands() const;
 	const std::string&				getSender() const;
+	const time_t&					getFloodTime() const;
+	const unsigned long&			getFanoutMark() const;
 	const std::string				getChannelJoined() const;
+	InputBuffer&					getInput();
 
 	void							updateSender();
-	void							addCommand(std::string const & command);
 	
 	//CONNECTIONS
-	int								createUserSocket(int socketServer);
 	void							quit(Server  & server, std::string const & reason);
 	const bool&						isConnected() const;
 	const bool&						isSent() const;
 
+	//OUTPUT QUEUE
+	void							queueMessage(SharedBuffer const &message);
+	int								sendPending();
+	void							consumeOutput(size_t bytes);
+	void							releaseSendQueue(SendQueue &queue);
+	bool							hasPendingOutput() const;
+	const SendQueue&				getSendQueue() const;
+	const bool&						isWriteArmed() const;
+	const bool&						isFlushPending() const;
+	const bool&						isClosing() const;
+	const bool&						isOperator() const;
+
 	//CHANNEL MANAGEMENT
-	void	addChannel(Channel *channel);
-	void	leaveChannel(Channel *channel);
+	void								linkMembership(Membership *membership);
+	void								unlinkMembership(Membership *membership);
+	const std::vector<Membership *>&	getMemberships() const;
+	void								addInvitation(std::string const &channelName);
 
 	//USER INFO
 	void	whoIs(Server const &server, User &requestingUser) const;
@@ -68,7 +95,7 @@ private:
 	std::string 			_username;
 	std::string 			_nickname;
 	
-	std::string 			_commandBuffer;
+	InputBuffer				_input;
 
 	int 					_socket;
 	struct sockaddr_in		_addr;
@@ -77,11 +104,19 @@ private:
 
 	bool					_isConnected;
 
-	std::deque<std::string>	_commands;
-	std::vector<Channel *>	_channelsJoined;
+	std::vector<Membership *>	_memberships;
+	std::vector<std::string>	_invitations;
 
 	bool					_connectionSent;
 
+	SendQueue				_sendQueue;
+	bool					_writeArmed;
+	bool					_flushPending;
+	bool					_closing;
+	bool					_operator;
+
+	time_t					_floodTime;
+	unsigned long			_fanoutMark;
 };
 
 #endif
\ No newline at end of file
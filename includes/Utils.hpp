@@ -14,12 +14,18 @@
 
 # include <unistd.h>
 # include <fcntl.h>
+# include <time.h>
 
 # include <sys/socket.h>
 
+# define NICKNAME_MAX 12
+
 void	    displayStringVector(std::vector<std::string> strings);
 int	        toInt(std::string s);
 std::string toString(int n);
 bool        isValidName(std::string const &name);
+std::string ircLower(std::string const &name);
+bool        isChannelName(std::string const &name);
+unsigned long	monotonicNanoseconds();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include "Allocation.hpp"
+
+#include <new>
+#include <stdlib.h>
+
+namespace {
+
+	__thread unsigned long	t_allocations = 0;
+	unsigned long			g_allocations = 0;
+
+}
+
+unsigned long	threadAllocations() { return (t_allocations); }
+unsigned long	totalAllocations() { return (__atomic_load_n(&g_allocations, __ATOMIC_RELAXED)); }
+
+/*
+Counts the allocation, then behaves like the default operator new:
+retries through the new handler, throws std::bad_alloc without one.
+operator new[] and the nothrow versions go through this one.
+*/
+void	*operator new(std::size_t size) throw(std::bad_alloc)
+{
+	void	*ptr;
+
+	++t_allocations;
+	__atomic_add_fetch(&g_allocations, 1, __ATOMIC_RELAXED);
+	if (size == 0)
+		size = 1;
+	while (!(ptr = malloc(size))) {
+		std::new_handler	handler = std::set_new_handler(NULL);
+
+		std::set_new_handler(handler);
+		if (!handler)
+			throw std::bad_alloc();
+		handler();
+	}
+	return (ptr);
+}
+
+void	operator delete(void *ptr) throw()
+{
+	free(ptr);
+}
@@ -0,0 +1,146 @@
+#include "Capture.hpp"
+#include "Logger.hpp"
+#include "Utils.hpp"
+
+#include <stdexcept>
+#include <string.h>
+#include <sys/resource.h>
+
+/******************************************************************************/
+/*									CAPTURE									  */
+/******************************************************************************/
+
+FILE			*Capture::_file = NULL;
+unsigned long	Capture::_start = 0;
+
+/* Creates the capture file, replacing an older one */
+void	Capture::start(std::string const &path)
+{
+	_file = fopen(path.c_str(), "wb");
+	if (!_file)
+		throw std::runtime_error("Error: cannot open capture file " + path);
+	setvbuf(_file, NULL, _IOFBF, CAPTURE_BUFFER_SIZE);
+	_start = monotonicNanoseconds();
+	if (fwrite(CAPTURE_MAGIC, 1, CAPTURE_MAGIC_LENGTH, _file) != CAPTURE_MAGIC_LENGTH)
+		throw std::runtime_error("Error: cannot write capture file " + path);
+}
+
+void	Capture::stop()
+{
+	if (!_file)
+		return ;
+	fclose(_file);
+	_file = NULL;
+}
+
+void	Capture::open(int socket, struct sockaddr_in const &addr)
+{
+	char	payload[CAPTURE_ADDRESS_LENGTH];
+
+	memcpy(payload, &addr.sin_addr.s_addr, 4);
+	memcpy(payload + 4, &addr.sin_port, 2);
+	write(socket, CAPTURE_OPEN, payload, sizeof(payload));
+}
+
+void	Capture::data(int socket, const char *data, size_t length)
+{
+	if (length)
+		write(socket, CAPTURE_DATA, data, length);
+}
+
+void	Capture::close(int socket) { write(socket, CAPTURE_CLOSE, NULL, 0); }
+
+/* Appends a record to the stream buffer, stops capturing on a write error */
+void	Capture::write(int socket, CaptureEvent event, const char *payload, size_t length)
+{
+	char			header[CAPTURE_HEADER_LENGTH];
+	uint64_t const	time = monotonicNanoseconds() - _start;
+	uint32_t const	fd = socket;
+	uint32_t const	size = length;
+	uint8_t const	type = event;
+
+	if (!_file)
+		return ;
+	memcpy(header, &time, 8);
+	memcpy(header + 8, &fd, 4);
+	memcpy(header + 12, &size, 4);
+	memcpy(header + 16, &type, 1);
+	if (fwrite(header, 1, sizeof(header), _file) != sizeof(header)
+		|| (length && fwrite(payload, 1, length, _file) != length)) {
+		LOG_ERROR << "capture write failed, capture stopped";
+		stop();
+	}
+}
+
+/******************************************************************************/
+/*									READER									  */
+/******************************************************************************/
+
+/*
+Opens a capture file, throws when it is missing or not a capture.
+The size of a file which can't seek, a pipe, is left unknown.
+*/
+CaptureReader::CaptureReader(std::string const &path) :
+	_file(fopen(path.c_str(), "rb")),
+	_remaining(static_cast<unsigned long>(-1)),
+	_socketMax(CAPTURE_SOCKET_MAX)
+{
+	char			magic[CAPTURE_MAGIC_LENGTH];
+	long			size;
+	struct rlimit	limit;
+
+	if (!_file)
+		throw std::runtime_error("Error: cannot open capture file " + path);
+	if (fread(magic, 1, sizeof(magic), _file) != sizeof(magic)
+		|| memcmp(magic, CAPTURE_MAGIC, sizeof(magic)) != 0) {
+		fclose(_file);
+		throw std::runtime_error("Error: " + path + " is not a capture file");
+	}
+	if (fseek(_file, 0, SEEK_END) == 0 && (size = ftell(_file)) != -1
+		&& fseek(_file, CAPTURE_MAGIC_LENGTH, SEEK_SET) == 0)
+		_remaining = size - CAPTURE_MAGIC_LENGTH;
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY
+		&& limit.rlim_cur < _socketMax)
+		_socketMax = limit.rlim_cur;
+}
+
+CaptureReader::~CaptureReader() { fclose(_file); }
+
+/*
+Reads the next record:
+- Success: returns true,
+- End of the file: returns false, a truncated last record included,
+- Corrupted length or socket: logs it and returns false.
+*/
+bool	CaptureReader::next(CaptureRecord &record)
+{
+	char		header[CAPTURE_HEADER_LENGTH];
+	uint32_t	length;
+
+	if (fread(header, 1, sizeof(header), _file) != sizeof(header))
+		return (false);
+	_remaining -= sizeof(header);
+	memcpy(&record.time, header, 8);
+	memcpy(&record.socket, header + 8, 4);
+	memcpy(&length, header + 12, 4);
+	memcpy(&record.event, header + 16, 1);
+	if (length > CAPTURE_PAYLOAD_MAX) {
+		LOG_ERROR << "capture file corrupted: record of " << length << " bytes";
+		return (false);
+	}
+	if (record.socket >= _socketMax) {
+		LOG_ERROR << "capture file corrupted: socket " << record.socket;
+		return (false);
+	}
+	if (length > _remaining) {
+		LOG_WARN << "capture file truncated";
+		return (false);
+	}
+	_remaining -= length;
+	record.payload.resize(length);
+	if (length && fread(&record.payload[0], 1, length, _file) != length) {
+		LOG_WARN << "capture file truncated";
+		return (false);
+	}
+	return (true);
+}
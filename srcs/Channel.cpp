@@ -7,7 +7,7 @@
 /* Default constructor initializing channel's names and topic strings as empty.*/
 Channel::Channel() :
 	_name(""),
-	_userList(""),
+	_namesCached(false),
 	_userLimit(0),
 	_inviteOnly(false),
 	_creator(""),
@@ -24,7 +24,7 @@ Channel::Channel() :
 /* Parametrical constructor*/
 Channel::Channel(const std::string name, const std::string creator, const std::string time) :
 	_name(name),
-	_userList(""),
+	_namesCached(false),
 	_userLimit(0),
 	_inviteOnly(false),
 	_creator(creator),
@@ -41,6 +41,12 @@ Channel::Channel(const std::string name, const std::string creator, const std::s
 /*Destructor*/
 Channel::~Channel() {}
 
+/* Channels live in slabs of CHANNEL_POOL_SLAB, recycled as they are created and emptied */
+static ObjectPool	g_channelPool(sizeof(Channel), CHANNEL_POOL_SLAB);
+
+void	*Channel::operator new(size_t size) { return (g_channelPool.allocate(size)); }
+void	Channel::operator delete(void *ptr, size_t size) { g_channelPool.release(ptr, size); }
+
 /******************************************************************************/
 /*							SETTERS AND GETTER		 						  */
 /******************************************************************************/
@@ -48,7 +54,7 @@ Channel::~Channel() {}
 void	Channel::setName(std::string const & name) { _name = name; }
 
 const std::string				&Channel::getName() const { return (_name); }
-const std::map<User *, bool>	&Channel::getMembers() const { return (_members); }
+const MemberList				&Channel::getMembers() const { return (_members); }
 bool    						Channel::isEmpty() const { return (_members.empty()); }
 const std::string				&Channel::getTopic() const { return (_topic);}
 const std::string				&Channel::getTopicUpdateUser() const { return (_topicUpdateUser);}
@@ -79,14 +85,13 @@ bool	Channel::addUser(Server const &server, User &user, std::string password, bo
 		return (false);
 	}
 
-	std::vector<User *>::iterator inviteIt = std::find(_pendingUserInvitations.begin(), _pendingUserInvitations.end(), &user);
-	if (_inviteOnly && inviteIt == _pendingUserInvitations.end()) {
+	if (_inviteOnly && !_pendingUserInvitations.contains(&user)) {
 		mess = ERR_CHANNELUSERNOTINVIT(user.getNickname(), _name)
 		server.sendMessageToUser(user, mess);
 		return (false);
 
 	} else if (_inviteOnly) {
-		_pendingUserInvitations.erase(inviteIt);
+		_pendingUserInvitations.erase(&user);
 	}
 	
 	if (_userLimit != 0 && _members.size() == _userLimit) {
@@ -95,29 +100,17 @@ bool	Channel::addUser(Server const &server, User &user, std::string password, bo
 		return (false);
 
 	} else {
-		_members.insert(std::make_pair(&user, op));
+		_members.add(&user, this, op ? MEMBER_OP : 0);
 	}
 	
-	updateUserList();
-
-	mess = CMD_JOIN(user.getSender(), _name);
-	server.sendMessageToALL(user, _members, mess);
-
-	mess = RPL_TOPIC(user.getNickname(), _name, _topic);
-	server.sendMessageToUser(user, mess);
+	invalidateNames();
 
-	mess = RPL_TOPICWHOTIME(user.getNickname(), _name, _topicUpdateUser, _topicUpdateTimestamp);
-	server.sendMessageToUser(user, mess);
-
-	mess = RPL_CREATIONTIME(user.getNickname(), _name, _creationTime);
-	server.sendMessageToUser(user, mess);
-
-	mess = RPL_NAMREPLY(user.getNickname(), _name, _userList);
-	server.sendMessageToUser(user, mess);
-
-	mess = RPL_ENDOFNAMES(user.getNickname(), _name);
-	server.sendMessageToUser(user, mess);
+	server.sendMessageToALL(user, _members, Reply(CMD_JOIN).arg(user.getSender()).arg(_name).buffer());
+	server.sendMessageToUser(user, Reply(RPL_TOPIC).arg(user.getNickname()).arg(_name).arg(_topic).buffer());
+	server.sendMessageToUser(user, Reply(RPL_TOPICWHOTIME).arg(user.getNickname()).arg(_name).arg(_topicUpdateUser).arg(_topicUpdateTimestamp).buffer());
+	server.sendMessageToUser(user, Reply(RPL_CREATIONTIME).arg(user.getNickname()).arg(_name).arg(_creationTime).buffer());
 
+	names(server, user);
 	who(server, user, false);
 	return (true);
 }
@@ -192,7 +185,8 @@ void	Channel::inviteUser(Server const &server, User &invitedUser, User &inviting
 		return ;
 	}
 
-	_pendingUserInvitations.push_back(&invitedUser);
+	_pendingUserInvitations.insert(&invitedUser, 0);
+	invitedUser.addInvitation(_name);
 
 	//sending invitation to the invited user
 	mess = CMD_INVITE(invitingUser.getSender(), invitedUser.getNickname(), _name);
@@ -209,21 +203,12 @@ void	Channel::inviteUser(Server const &server, User &invitedUser, User &inviting
 	server.sendMessageToALL(invitingUser, _members, mess);
 }
 
-/* Notify channel users about a chan user who quitted the server, before proceding to erase the member from the container of users and updating the user list */
-void	Channel::quit(Server const &server, User &quiter, std::string const & reason)
-{
-	std::string mess = CMD_QUIT(quiter.getSender(), reason);
-	server.sendMessageToALL(quiter, _members, mess);
-	removeUser(quiter);
-}
-
 void	Channel::removeUser(User & user)
 {
-	std::map<User *, bool>::iterator it = _members.find(&user);
-	if (it == _members.end())
+	_pendingUserInvitations.erase(&user);
+	if (!_members.remove(&user))
 		return ;
-	_members.erase(it);
-	updateUserList();
+	invalidateNames();
 }
 
 /******************************************************************************/
@@ -352,9 +337,9 @@ void	Channel::updateMode(Server const &server, User &user, std::vector<std::stri
 					return ;
 				}
 
-				std::map<User *, bool>::iterator targetIt = _members.find(target);
-				targetIt->second = change;
-				updateUserList();
+				Membership	*member = _members.find(target);
+				member->modes = change ? (member->modes | MEMBER_OP) : (member->modes & ~MEMBER_OP);
+				invalidateNames();
 
 				mess = CMD_MODE(user.getSender(), _name, ((change) ? "+" : "-"), options[i], target->getNickname());
 				server.sendMessageToALL(user, _members, mess);
@@ -388,19 +373,43 @@ void	Channel::updateMode(Server const &server, User &user, std::vector<std::stri
 	return ;
 }
 
-/* Updates user list of the canal, adds @ in front of operator users */
-void	Channel::updateUserList()
+/* Drops the cached names reply, rebuilt by the next names() */
+void	Channel::invalidateNames()
 {
-	_userList.clear();
-	for (std::map<User *, bool>::iterator it = _members.begin(); it != _members.end(); it++)
+	_namesCached = false;
+	_names.clear();
+}
+
+/*
+Splits the member list, with @ in front of operator users, into the
+parameters of 353 lines: a line holds as many names as fit in 512 bytes
+once the prefix for the longest possible nickname is added.
+*/
+void	Channel::buildNames()
+{
+	size_t		prefix = strlen(SERVER_NAME) + strlen("353 ") + NICKNAME_MAX + strlen(" = ") + _name.length() + strlen(" :\r\n");
+	size_t		budget = prefix < MESSAGE_LENGTH_MAX ? MESSAGE_LENGTH_MAX - prefix : 0;
+	std::string	line;
+
+	_names.clear();
+	for (size_t i = 0; i < _members.size(); i++)
 	{
-		User *user = it->first;
-		bool op = it->second;
-		if (op)
-			_userList.append("@");
-		_userList.append(user->getNickname() + " ");
+		std::string const	&nick = _members[i].user->getNickname();
+		size_t				length = nick.length() + ((_members[i].modes & MEMBER_OP) ? 1 : 0);
+
+		if (!line.empty() && line.length() + 1 + length > budget) {
+			_names.push_back(line);
+			line.clear();
+		}
+		if (!line.empty())
+			line.append(" ");
+		if (_members[i].modes & MEMBER_OP)
+			line.append("@");
+		line.append(nick);
 	}
-	return ;
+	if (!line.empty())
+		_names.push_back(line);
+	_namesCached = true;
 }
 
 /******************************************************************************/
@@ -409,26 +418,14 @@ void	Channel::updateUserList()
 
 /* Checks if the user given as parameter is operator on the channel */
 bool	Channel::userIsOP(User &user) {
-	std::map<User *, bool>::iterator	it = _members.find(&user);
-
-	if (it != _members.end() && it->second == false) {
-		return (false);
-	}
+	Membership const	*member = _members.find(&user);
 
-	return (true);
+	return (member && (member->modes & MEMBER_OP));
 }
 
 /* Checks if the user given as parameter is on the channel */
 bool	Channel::userOnChannel(User &user) {
-	std::map<User *, bool>::iterator	it = _members.find(&user);
-
-	if (it == _members.end()) {
-		// std::string mess = ERR_NOTONCHANNEL(user.getNickname(), _name);
-		// server.sendMessageToUser(user, mess);
-		return (false);
-	}
-
-	return (true);
+	return (_members.contains(&user));
 }
 
 /* Updates user list of the canal, adds @ in front of operator users */
@@ -448,15 +445,24 @@ void    Channel::who(Server const & server, User &user, bool checkNeeded)
 	}
 
 	//send one message per information to the user requesting information about channel users
-	std::string	informationUserList;
-	for (std::map<User *, bool>::iterator it = _members.begin(); it != _members.end(); it++)
+	for (size_t i = 0; i < _members.size(); i++)
 	{
-		User	&userChan = *(it->first);
-		bool	isChanOp = it->second;
-		informationUserList = userChan.getNickname() + " " + userChan.getSender() + " " + userChan.getUsername() + " :" + (isChanOp ? "@" : "");
-		mess = RPL_WHOREPLY(user.getNickname(), _name, informationUserList);
-		server.sendMessageToUser(user, mess);
+		User	&userChan = *_members[i].user;
+		bool	isChanOp = _members[i].modes & MEMBER_OP;
+
+		server.sendMessageToUser(user, Reply(RPL_WHOREPLY).arg(user.getNickname()).arg(_name)
+			.arg(userChan.getNickname()).arg(userChan.getSender()).arg(userChan.getUsername()).arg(isChanOp ? "@" : "").buffer());
 	}
-	mess = RPL_ENDOFWHO(user.getNickname(), _name);
-	server.sendMessageToUser(user, mess);
+	server.sendMessageToUser(user, Reply(RPL_ENDOFWHO).arg(user.getNickname()).arg(_name).buffer());
+}
+
+/* Sends the member list in 353 lines of at most 512 bytes, built once until the membership changes, then 366 */
+void	Channel::names(Server const &server, User &user)
+{
+	if (!_namesCached)
+		buildNames();
+
+	for (size_t i = 0; i < _names.size(); i++)
+		server.sendMessageToUser(user, Reply(RPL_NAMREPLY).arg(user.getNickname()).arg(_name).arg(_names[i]).buffer());
+	server.sendMessageToUser(user, Reply(RPL_ENDOFNAMES).arg(user.getNickname()).arg(_name).buffer());
 }
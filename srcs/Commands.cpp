@@ -1,5 +1,16 @@
 #include "Server.hpp"
 
+/*
+Parameter of a command at index, empty when it has fewer. The text of
+PRIVMSG, TOPIC, PART... is read at its position, trailing or not.
+*/
+static std::string const	&param(std::vector<std::string> const &args, size_t index)
+{
+	static std::string const	empty;
+
+	return (index < args.size() ? args[index] : empty);
+}
+
 /******************************************************************************/
 /*									CONNECTION PART							*/
 /******************************************************************************/
@@ -20,9 +31,9 @@ void	Server::checkConnection(User &user) {
 }
 
 /*Checks if password given by the user is right*/
-bool	Server::password(User &user, std::vector<std::string> const &args) {
+void	Server::password(User &user, std::vector<std::string> const &args, std::string const &) {
 	if (user.isConnected())
-		return (true);
+		return ;
 
 	std::string	mess;
 
@@ -32,38 +43,29 @@ bool	Server::password(User &user, std::vector<std::string> const &args) {
 		mess = CMD_NOTICE_TARGET(SERVER_NAME, std::string("*** Wrong password, please try again..."), std::string("AUTH"));
 		sendMessageToUser(user, mess);
 		removeUser(user, "");
-		return (false);
 	} else {
 		mess = CMD_NOTICE_TARGET(SERVER_NAME, std::string("*** Password is correct..."), std::string("AUTH"));
 		sendMessageToUser(user, mess);
 		user.setStatus(true);
 		checkConnection(user);
-		return (true);
 	}
 }
 
 /*Checks the username and sets it*/
-void	Server::userName(User &user, std::vector<std::string> const &args)
+void	Server::userName(User &user, std::vector<std::string> const &args, std::string const &)
 {
 	std::string	mess;
 	mess = CMD_NOTICE_TARGET(SERVER_NAME, std::string("*** Checking your username..."), std::string("AUTH"));
 	sendMessageToUser(user, mess);
 
-	if (args.size() < 1) {
-		mess = CMD_NOTICE_TARGET(SERVER_NAME, std::string("*** Your username is empty..."), std::string("AUTH"));
-		sendMessageToUser(user, mess);
-		return ;
-
-	} else {
-		user.setUsername(args[0]);
-		mess = CMD_NOTICE_TARGET(SERVER_NAME, std::string("*** Username successfully set..."), std::string("AUTH"));
-		sendMessageToUser(user, mess);
-		checkConnection(user);
-	}
+	user.setUsername(args[0]);
+	mess = CMD_NOTICE_TARGET(SERVER_NAME, std::string("*** Username successfully set..."), std::string("AUTH"));
+	sendMessageToUser(user, mess);
+	checkConnection(user);
 }
 
 /*Checks the nickname and sets it*/
-void	Server::nickName(User &user, std::vector<std::string> const &args)
+void	Server::nickName(User &user, std::vector<std::string> const &args, std::string const &)
 {
 	std::string	mess;
 	mess = CMD_NOTICE_TARGET(SERVER_NAME, std::string("*** Checking your nickname..."), std::string("AUTH"));
@@ -74,7 +76,9 @@ void	Server::nickName(User &user, std::vector<std::string> const &args)
 	}
 
 	try {
-		if (findUserByNickname(args[0])) {
+		User	*owner = findUserByNickname(args[0]);
+
+		if (owner && owner != &user) {
 
 			if (!user.isSent()) {
 				std::string	err = ERR_NICKNAMEINUSE("*", args[0]);
@@ -85,13 +89,13 @@ void	Server::nickName(User &user, std::vector<std::string> const &args)
 			}
 		} else {
 			if (!user.isSent()) {
-				user.setNickname(args[0]);
+				setNickname(user, args[0]);
 				mess = CMD_NICK(user.getSender(), args[0]);
 				sendMessageToUser(user, mess);
 			} else {
 				mess = CMD_NICK(user.getSender(), args[0]);
-				sendMessageToUser(user, mess);
-				user.setNickname(args[0]);
+				sendMessageToNeighbours(user, mess);
+				setNickname(user, args[0]);
 			}
 		}
 
@@ -101,11 +105,17 @@ void	Server::nickName(User &user, std::vector<std::string> const &args)
 		checkConnection(user);
 
 	} catch(const std::exception& e) {
-		std::cerr << e.what() << std::endl;
+		LOG_DEBUG << e.what();
 		sendMessageToUser(user, e.what());
 	}
 }
 
+/*Leaves the server, the last parameter being the reason*/
+void	Server::userQuit(User &user, std::vector<std::string> const &args, std::string const &)
+{
+	removeUser(user, args.empty() ? "" : args.back());
+}
+
 /*
 Sends a formatted welcome message to
 a newly connected user to the server.
@@ -139,22 +149,18 @@ void    Server::welcome(User &user) const
 /*
 Sends a formatted "PONG" response to a user,
 typically used to respond to a "PING" message from the IRC server to keep the connection active. */
-void	Server::pong(const User &user, std::vector<std::string> const & args) const
+void	Server::pong(User &user, std::vector<std::string> const & args, std::string const &)
 {
-	if (args.size() < 1)
-		return;
 	std::string const & message = args[0];
 	std::string mess = CMD_PING(message, user.getNickname());
 	sendMessageToUser(user, mess);
 }
 
 /*Display informations about a user of the server*/
-void	Server::whoIs(User &requestingUser, std::vector<std::string> const &args) const
+void	Server::whoIs(User &requestingUser, std::vector<std::string> const &args, std::string const &)
 {
 	std::string	mess;
 
-	if (args.size() < 1)
-		return ;
 	std::string const & investigatedUserNick = args[0];
 
 	User 	*investigatedUser;
@@ -172,21 +178,17 @@ void	Server::whoIs(User &requestingUser, std::vector<std::string> const &args) c
 }
 
 /*Format and send a message to the user to inform them about a new private message*/
-void	Server::privmsg(const User &user, std::vector<std::string> const & args, std::string const &message) const
+void	Server::privmsg(User &user, std::vector<std::string> const & args, std::string const &)
 {
-	if (args.size() < 1)
-		return;
-	std::string mess = CMD_PRIVMSG(user.getSender(), args[0], message);
-
-	sendMessage(user, args[0], mess);
+	sendMessage(user, args[0], Reply(CMD_PRIVMSG).arg(user.getSender()).arg(args[0]).arg(param(args, 1)).buffer());
 }
 
 /*Sends a notice to the user*/
-void	Server::notice(User &user, std::vector<std::string> const &	args)
+void	Server::notice(User &user, std::vector<std::string> const &	args, std::string const &)
 {
 	std::string	mess;
 	User *userTarget;
-	mess = CMD_NOTICE_TARGET(user.getSender(), mess, args[0]); // ???
+	mess = CMD_NOTICE_TARGET(user.getSender(), ":" + param(args, 1), args[0]);
 
 	try
 	{
@@ -201,44 +203,76 @@ void	Server::notice(User &user, std::vector<std::string> const &	args)
 }
 
 /*Display informations about a user of the server*/
-void	Server::userHost(User &user, std::vector<std::string> const &args)
+void	Server::userHost(User &user, std::vector<std::string> const &args, std::string const &)
 {
 	std::string		messtmp = "";
 
 	std::string		mess;
 	std::string 	infoTarget = "";
-	if (args.size() == 0)
-	{
-		mess = RPL_USERHOST(user.getNickname(), infoTarget);
-	}
-	else
+
+	for (size_t i = 0; i < args.size(); i++)
 	{
-		for (size_t i = 0; i < args.size(); i++)
+		User *userTarget;
+
+		try
 		{
-			User *userTarget;
-
-			try
-			{
-				userTarget = findUserByNickname(args[i], user);
-				std::string adress = inet_ntoa(userTarget->getAddr().sin_addr);
-				infoTarget = args[i] + "=+~" + userTarget->getUsername() + "@" + adress;
-				messtmp += infoTarget + " ";
-			}
-			catch(const std::exception& e){}
+			userTarget = findUserByNickname(args[i], user);
+			std::string adress = inet_ntoa(userTarget->getAddr().sin_addr);
+			infoTarget = args[i] + "=+~" + userTarget->getUsername() + "@" + adress;
+			messtmp += infoTarget + " ";
 		}
-		mess = RPL_USERHOST(user.getNickname(), messtmp);
-
+		catch(const std::exception& e){}
 	}
+	mess = RPL_USERHOST(user.getNickname(), messtmp);
 
 	sendMessageToUser(user, mess);
 }
 
+/*
+Grants the operator privileges when the password matches --oper-password,
+never when the server was started without one
+*/
+void	Server::oper(User &user, std::vector<std::string> const &args, std::string const &)
+{
+	if (_config.operPassword.empty() || args[1] != _config.operPassword) {
+		LOG_WARN << "failed OPER attempt by " << user.getNickname() << " from " << user.getInet();
+		sendMessageToUser(user, Reply(ERR_PASSWDMISMATCH).arg(user.getNickname()).buffer());
+		return ;
+	}
+	user.setOperator(true);
+	LOG_INFO << user.getNickname() << " is now an operator";
+	sendMessageToUser(user, Reply(RPL_YOUREOPER).arg(user.getNickname()).buffer());
+}
+
+/* Sends the metrics of the server to an operator, one sample per line */
+void	Server::stats(User &user, std::vector<std::string> const &args, std::string const &)
+{
+	std::string const	query = args.empty() ? "*" : args[0];
+	std::string const	metrics = renderMetrics();
+	size_t				start = 0;
+	size_t				end;
+
+	if (!user.isOperator()) {
+		sendMessageToUser(user, Reply(ERR_NOPRIVILEGES).arg(user.getNickname()).buffer());
+		return ;
+	}
+
+	for (; start < metrics.length(); start = end + 1) {
+		end = metrics.find('\n', start);
+		if (end == std::string::npos)
+			end = metrics.length();
+		if (metrics[start] != '#')
+			sendMessageToUser(user, Reply(RPL_STATSDEBUG).arg(user.getNickname()).arg(metrics.data() + start, end - start).buffer());
+	}
+	sendMessageToUser(user, Reply(RPL_ENDOFSTATS).arg(user.getNickname()).arg(query).buffer());
+}
+
 /******************************************************************************/
 /*								   	CHANNEL COMMANDS									*/
 /******************************************************************************/
 
 /*Checks the parameters, creates the channels if it doesnt exists then tries to add the user to the channel*/
-void	Server::joinChannel(User &user, std::vector<std::string> const &args)
+void	Server::joinChannel(User &user, std::vector<std::string> const &args, std::string const &)
 {
 	std::string channelName;
 	std::string	password;
@@ -248,15 +282,8 @@ void	Server::joinChannel(User &user, std::vector<std::string> const &args)
 	std::string	chanBuffer;
 	std::string	passBuffer;
 
-	try {
-		if (args.size() == 0 || args.size() > 2)
-			throw needMoreParams(user.getNickname(), "JOIN");
-	} catch(const std::exception& e) {
-		sendMessageToUser(user, e.what());
-		return ;
-	}
-
-	if (args.size() == 2)
+	// parameters past the keys are ignored
+	if (args.size() >= 2)
 		passBuffer = args[1];
 
 	size_t	pos;
@@ -273,14 +300,7 @@ void	Server::joinChannel(User &user, std::vector<std::string> const &args)
 			chanBuffer = chanBuffer.substr(++pos, chanBuffer.length());
 		}
 
-		try {
-			channel = findChannelByName(channelName, user);
-		} catch(const std::exception& e) {
-			channel = createChannel(user, channelName);
-			op =  true;
-		}
-
-		if (args.size() == 2) {
+		if (args.size() >= 2) {
 			pos = passBuffer.find(',');
 			if (pos ==  std::string::npos) {
 				pos = passBuffer.length();
@@ -292,36 +312,35 @@ void	Server::joinChannel(User &user, std::vector<std::string> const &args)
 				passBuffer = passBuffer.substr(++pos, passBuffer.length());
 			}
 		}
+
+		if (!isChannelName(channelName)) {
+			mess = ERR_NOSUCHCHAN(user.getNickname(), channelName);
+			sendMessageToUser(user, mess);
+			continue ;
+		}
+
+		channel = findChannel(channelName);
+		op = (channel == NULL);
+		if (!channel)
+			channel = createChannel(user, channelName);
 		
-		if (channel->addUser(*this, user, password, op))
-			user.addChannel(channel);
+		channel->addUser(*this, user, password, op);
 	}
 }
 
 /*Checks the parameters,then tries to invite the user to the channel*/
-void	Server::inviteChannel(User &invitingUser, std::vector<std::string> const & args)
+void	Server::inviteChannel(User &invitingUser, std::vector<std::string> const & args, std::string const &)
 {
 	std::string	mess;
 
-	try 
-	{
-		if (args.size() < 2)
-			throw needMoreParams(invitingUser.getNickname(), "INVITE");
-	}
-	catch(const std::exception& e)
-	{
-		sendMessageToUser(invitingUser, e.what());
-		return ;
-	}
-
 	std::string const & invited = args[0];
 	std::string const & channelName = args[1];
 	
 	Channel	*channel;
-	try {
-		channel = findChannelByName(channelName, invitingUser);
-	} catch(const std::exception& e) {
-		sendMessageToUser(invitingUser, e.what());
+	channel = findChannel(channelName);
+	if (!channel) {
+		mess = ERR_NOSUCHCHAN(invitingUser.getNickname(), channelName);
+		sendMessageToUser(invitingUser, mess);
 		return ;
 	}
 
@@ -340,62 +359,36 @@ void	Server::inviteChannel(User &invitingUser, std::vector<std::string> const &
 }
 
 /*Checks the parameters, then tries to remove the user from the channel*/
-void	Server::partChannel(User &user,std::vector<std::string> const & args, std::string const & reason)
+void	Server::partChannel(User &user,std::vector<std::string> const & args, std::string const &)
 {
 	std::string const	&channelName = args[0];
 	Channel				*channel;
 	std::string			mess;
 
-	try 
-	{
-		if (args.size() < 1)
-			throw needMoreParams(user.getNickname(), "PART");
-	}
-	catch(const std::exception& e)
-	{
-		sendMessageToUser(user, e.what());
-		return ;
-	}
-
-	try {
-		channel = findChannelByName(channelName, user);
-	} catch(const std::exception& e) {
-		sendMessageToUser(user, e.what());
+	channel = findChannel(channelName);
+	if (!channel) {
+		mess = ERR_NOSUCHCHAN(user.getNickname(), channelName);
+		sendMessageToUser(user, mess);
 		return ;
 	}
 
-	if (channel->partUser(*this, user, reason))
-	{
-		user.leaveChannel(channel);
-		if (channel->isEmpty())
-			removeChannel(channel);
-	}
+	if (channel->partUser(*this, user, param(args, 1)) && channel->isEmpty())
+		removeChannel(channel);
 }
 
 /*Checks the parameters,then tries to kick the user to the channel*/
-void	Server::kickChannel(User &kicker, std::vector<std::string> const & args, std::string const & reason) //peut etre merge avec part plus tard, mais la cest pour eviter les pb
+void	Server::kickChannel(User &kicker, std::vector<std::string> const & args, std::string const &) //peut etre merge avec part plus tard, mais la cest pour eviter les pb
 {
 	std::string	mess;
 
-	try 
-	{
-		if (args.size() < 2)
-			throw needMoreParams(kicker.getNickname(), "KICK");
-	}
-	catch(const std::exception& e)
-	{
-		sendMessageToUser(kicker, e.what());
-		return ;
-	}
-
 	std::string const &channelName = args[0];
 	std::string const &kickedNick = args[1];
 	
 	Channel	*channel;
-	try {
-		channel = findChannelByName(channelName, kicker);
-	} catch(const std::exception& e) {
-		sendMessageToUser(kicker, e.what());
+	channel = findChannel(channelName);
+	if (!channel) {
+		mess = ERR_NOSUCHCHAN(kicker.getNickname(), channelName);
+		sendMessageToUser(kicker, mess);
 		return ;
 	}
 
@@ -403,12 +396,8 @@ void	Server::kickChannel(User &kicker, std::vector<std::string> const & args, st
 	try
 	{
 		kickedUser = findUserByNickname(kickedNick, kicker);
-		if (channel->kickUser(*this, *kickedUser, kicker, reason))
-		{
-			kickedUser->leaveChannel(channel);
-			if (channel->isEmpty())
-				removeChannel(channel);
-		}
+		if (channel->kickUser(*this, *kickedUser, kicker, param(args, 2)) && channel->isEmpty())
+			removeChannel(channel);
 	}
 	catch(const std::exception& e)
 	{
@@ -418,70 +407,43 @@ void	Server::kickChannel(User &kicker, std::vector<std::string> const & args, st
 }
 
 /*Checks the parameters,then tries to updates the channel topic*/
-void	Server::topicChannel(User &user, std::vector<std::string> const & args, std::string const & topic)
+void	Server::topicChannel(User &user, std::vector<std::string> const & args, std::string const &)
 {
 	std::string	mess;
-	
-	try 
-	{
-		if (args.size() < 1)
-			throw needMoreParams(user.getNickname(), "TOPIC");
-	}
-	catch(const std::exception& e)
-	{
-		sendMessageToUser(user, e.what());
-		return ;
-	}
-
 
 	std::string const & channelName = args[0];
 
 	Channel	*channel;
 
-	try {
-		channel = findChannelByName(channelName, user);
-	} catch(const std::exception& e) {
-		sendMessageToUser(user, e.what());
+	channel = findChannel(channelName);
+	if (!channel) {
+		mess = ERR_NOSUCHCHAN(user.getNickname(), channelName);
+		sendMessageToUser(user, mess);
 		return ;
 	}
 	
 	if (args.size() == 1) {
-		mess = RPL_TOPIC(user.getNickname(), channel->getName(), channel->getTopic());
-		sendMessageToUser(user, mess);
-
-		mess = RPL_TOPICWHOTIME(user.getNickname(), channel->getName(), channel->getTopicUpdateUser(), channel->getTopicUpdateTimestamp());
-		sendMessageToUser(user, mess);
+		sendMessageToUser(user, Reply(RPL_TOPIC).arg(user.getNickname()).arg(channel->getName()).arg(channel->getTopic()).buffer());
+		sendMessageToUser(user, Reply(RPL_TOPICWHOTIME).arg(user.getNickname()).arg(channel->getName())
+			.arg(channel->getTopicUpdateUser()).arg(channel->getTopicUpdateTimestamp()).buffer());
 	} else {
-		channel->updateTopic(*this, user, topic);
+		channel->updateTopic(*this, user, args[1]);
 	}
 }
 
 /*Checks the parameters,then tries to change channel modes*/
-void	Server::modeChannel(User &user, std::vector<std::string> const &args)
+void	Server::modeChannel(User &user, std::vector<std::string> const &args, std::string const &)
 {
 	std::string	mess;
-	try 
-	{
-		if (args.empty())
-			throw needMoreParams(user.getNickname(), "MODE");
-	}
-	catch(const std::exception& e)
-	{
-		sendMessageToUser(user, e.what());
-		return ;
-	}
 
 	const std::string &target = args[0];
-	if (target[0] != '#') {
-		return ;
-	}
+	Channel	*channel = NULL;
 
-	Channel	*channel;
-	
-	try {
-		channel = findChannelByName(target, user);
-	} catch(const std::exception& e) {
-		sendMessageToUser(user, e.what());
+	if (isChannelName(target))
+		channel = findChannel(target);
+	if (!channel) {
+		mess = ERR_NOSUCHCHAN(user.getNickname(), target);
+		sendMessageToUser(user, mess);
 		return ;
 	}
 
@@ -489,23 +451,52 @@ void	Server::modeChannel(User &user, std::vector<std::string> const &args)
 }
 
 /*Display informations about users of a given channel*/
-void	Server::who(User &user, std::vector<std::string> const &args) const
+void	Server::who(User &user, std::vector<std::string> const &args, std::string const &)
 {
 	std::string	mess;
 	
-	if (args.size() < 1)
-		return ;
 	std::string const &channelName = args[0];
 
 	//checks if channel exists
 	Channel	*channel;
-	try {
-		channel = findChannelByName(channelName, user);
-	
-	} catch(const std::exception& e) {
-		sendMessageToUser(user, e.what());
+	channel = findChannel(channelName);
+	if (!channel) {
+		mess = ERR_NOSUCHCHAN(user.getNickname(), channelName);
+		sendMessageToUser(user, mess);
 		return ;
 	}
 	
 	channel->who(*this, user, true);
-}
\ No newline at end of file
+}
+/*
+Lists the members of the channels given in a comma separated list.
+An unknown channel, or no parameter, only gets the end of the list.
+*/
+void	Server::names(User &user, std::vector<std::string> const &args, std::string const &)
+{
+	std::string	mess;
+	std::string	channelName;
+	size_t		start = 0;
+	size_t		pos;
+
+	if (args.empty()) {
+		sendMessageToUser(user, Reply(RPL_ENDOFNAMES).arg(user.getNickname()).arg("*").buffer());
+		return ;
+	}
+
+	std::string const &list = args[0];
+	while (start <= list.length()) {
+		pos = list.find(',', start);
+		if (pos == std::string::npos)
+			pos = list.length();
+		channelName = list.substr(start, pos - start);
+		start = pos + 1;
+
+		Channel	*channel = findChannel(channelName);
+		if (channel) {
+			channel->names(*this, user);
+		} else {
+			sendMessageToUser(user, Reply(RPL_ENDOFNAMES).arg(user.getNickname()).arg(channelName).buffer());
+		}
+	}
+}
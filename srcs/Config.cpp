@@ -0,0 +1,92 @@
+#include "Config.hpp"
+
+#include <cctype>
+
+/* Default settings, used when an option is not given */
+Config::Config() :
+	edgeTriggered(false),
+	backend("epoll"),
+	reactors(1),
+	backlog(BACKLOG_DEFAULT),
+	acceptBudget(ACCEPT_BUDGET_DEFAULT),
+	floodLimit(0),
+	sendqLimit(SENDQ_DEFAULT),
+	allocStats(false),
+	logLevel(LEVEL_INFO),
+	logFile(""),
+	metricsSocket(""),
+	operPassword(""),
+	capture(""),
+	replay(""),
+	replayPaced(false)
+{}
+
+/* Converts a strictly positive number option, 0 when invalid */
+static size_t	toCount(std::string const &value)
+{
+	size_t	count = 0;
+
+	if (value.empty() || value.length() > 9)
+		return (0);
+	for (size_t i = 0; i < value.length(); ++i) {
+		if (!isdigit(value[i]))
+			return (0);
+		count = count * 10 + (value[i] - '0');
+	}
+	return (count);
+}
+
+/*
+Reads the options following <port> <password>,
+throws on unknown or malformed options.
+*/
+void	parseConfig(int argc, char **argv, Config &config)
+{
+	for (int i = 3; i < argc; ++i) {
+		std::string	option = argv[i];
+		std::string	value;
+		size_t		pos;
+
+		if (option.compare(0, 2, "--") != 0)
+			throw std::runtime_error(USAGE);
+
+		pos = option.find('=');
+		if (pos != std::string::npos) {
+			value = option.substr(pos + 1);
+			option = option.substr(0, pos);
+		}
+
+		if (option == "--edge-triggered" && value.empty())
+			config.edgeTriggered = true;
+		else if (option == "--backend" && (value == "epoll" || value == "uring"))
+			config.backend = value;
+		else if (option == "--reactors" && toCount(value) > 0 && toCount(value) <= REACTORS_MAX)
+			config.reactors = toCount(value);
+		else if (option == "--backlog" && toCount(value) > 0)
+			config.backlog = toCount(value);
+		else if (option == "--accept-budget" && toCount(value) > 0)
+			config.acceptBudget = toCount(value);
+		else if (option == "--flood-limit" && toCount(value) > 0)
+			config.floodLimit = toCount(value);
+		else if (option == "--sendq" && toCount(value) > 0)
+			config.sendqLimit = toCount(value);
+		else if (option == "--alloc-stats" && value.empty())
+			config.allocStats = true;
+		else if (option == "--log-level" && Logger::parseLevel(value) != -1)
+			config.logLevel = Logger::parseLevel(value);
+		else if (option == "--log-file" && !value.empty())
+			config.logFile = value;
+		else if (option == "--metrics-socket" && !value.empty())
+			config.metricsSocket = value;
+		else if (option == "--oper-password" && !value.empty())
+			config.operPassword = value;
+		else if (option == "--capture" && !value.empty())
+			config.capture = value;
+		else if (option == "--replay" && !value.empty())
+			config.replay = value;
+		else if (option == "--replay-pacing" && (value == "full" || value == "recorded"))
+			config.replayPaced = (value == "recorded");
+		else
+			throw std::runtime_error("Error: unknown option " + option);
+	}
+}
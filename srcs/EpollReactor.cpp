@@ -0,0 +1,232 @@
+#include "EpollReactor.hpp"
+#include "Server.hpp"
+
+/******************************************************************************/
+/*						CONSTRUCTORS & DESTRUCTORS							  */
+/******************************************************************************/
+
+EpollReactor::EpollReactor(Server &server, Config const &config) :
+	_server(server),
+	_edgeTriggered(config.edgeTriggered),
+	_acceptBudget(config.acceptBudget),
+	_socketServer(-1),
+	_epollfd(-1),
+	_epollEvents(config.edgeTriggered ? EPOLLIN | EPOLLET : EPOLLIN)
+{}
+
+/* Destructor, ensuring the epoll instance is closed */
+EpollReactor::~EpollReactor()
+{
+	if (_epollfd != -1)
+		close(_epollfd);
+}
+
+/******************************************************************************/
+/*						       EVENTS MANAGEMENT     						  */
+/******************************************************************************/
+
+/*
+Creates the epoll instance and adds the listening socket to it.
+The listening socket stays level-triggered in every mode.
+*/
+void	EpollReactor::start(int socketServer)
+{
+	struct epoll_event	ev;
+
+	_socketServer = socketServer;
+	_epollfd = epoll_create1(0);
+	if (_epollfd == -1) {
+		throw std::runtime_error("Error: failed to create epoll");
+	}
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = _socketServer;
+	if (epoll_ctl(_epollfd, EPOLL_CTL_ADD, _socketServer, &ev) == -1) {
+		throw std::runtime_error("Error: failed to manage sockets");
+	}
+}
+
+/*
+Waits for events on the watched sockets
+and handles them with handleEvents.
+An interrupted wait is not an error, the caller checks g_end.
+*/
+int	EpollReactor::poll()
+{
+	struct epoll_event	events[EVENTS_MAX];
+	int					nfds;
+
+	nfds = epoll_wait(_epollfd, events, EVENTS_MAX, -1);
+	if (nfds == -1)
+		return ((errno == EINTR) ? 0 : -1);
+	woke();
+
+	for (int n = 0; n < nfds; ++n) {
+		handleEvents(events[n].data.fd, events[n]);
+	}
+	return (0);
+}
+
+/*
+Handles events from epoll file descriptors:
+accepts new clients, flushes writable sockets,
+reads data from readable ones and hands it to the server.
+*/
+void	EpollReactor::handleEvents(int fd, struct epoll_event event)
+{
+	User	*user;
+
+	if (fd == _socketServer) { // First connection of a client
+		acceptConnection();
+		return ;
+	}
+
+	user = _server.findUserBySocket(fd);
+	if (!user)
+		return ;
+
+	if (event.events & EPOLLERR) {
+		_server.removeUser(*user, "Connection closed");
+		return ;
+	}
+
+	if ((event.events & EPOLLOUT) && flush(*user)) {
+		_server.removeUser(*user, "Connection closed");
+		return ;
+	}
+
+	if (!(event.events & EPOLLIN)) {
+		if (event.events & EPOLLHUP)
+			_server.removeUser(*user, "Connection closed");
+		return ;
+	}
+
+	int	status = receiveData(*user);
+	_server.handleInput(*user, status == -1);
+}
+
+/*
+Accepts the pending connections on the server socket until EAGAIN,
+creating a user for each of them. At most _acceptBudget are taken per
+tick so that a reconnection storm doesn't starve the connected clients,
+the listening socket is level-triggered and will be reported again.
+Out of file descriptors, the pending connections are refused.
+*/
+void	EpollReactor::acceptConnection()
+{
+	int			socket;
+	sockaddr_in	addr;
+	socklen_t	size;
+
+	for (size_t count = 0; count < _acceptBudget; ++count) {
+		size = sizeof(addr);
+		socket = accept4(_socketServer, (struct sockaddr *)&addr, &size, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (socket == -1 && (errno == EINTR || errno == ECONNABORTED))
+			continue ;
+		if (socket == -1 && (errno == EMFILE || errno == ENFILE) && _reserve.shed(_socketServer))
+			continue ;
+		if (socket == -1)
+			return ;
+
+		_server.createUser(socket, addr);
+	}
+}
+
+/*
+Receives data from the socket of a user directly into its input buffer.
+In edge-triggered mode the socket is drained until EAGAIN
+since epoll won't report it again, otherwise a single read is done.
+A drain stops after RECV_BUDGET bytes so that one client can't starve
+the others, the socket is then re-armed to be reported at the next tick.
+- Success: returns 0,
+- Connection closed or broken: returns -1.
+*/
+int	EpollReactor::receiveData(User &user)
+{
+	InputBuffer			&input = user.getInput();
+	struct epoll_event	ev;
+	size_t				received = 0;
+	ssize_t				bytes;
+
+	while (true) {
+		if (received >= RECV_BUDGET) {
+			memset(&ev, 0, sizeof(ev));
+			ev.events = user.isWriteArmed() ? _epollEvents | EPOLLOUT : _epollEvents;
+			ev.data.fd = user.getSocket();
+			return ((epoll_ctl(_epollfd, EPOLL_CTL_MOD, user.getSocket(), &ev) == -1) ? -1 : 0);
+		}
+
+		bytes = recv(user.getSocket(), input.reserve(BUFFER_SIZE), BUFFER_SIZE, 0);
+		if (bytes > 0) {
+			input.commit(bytes);
+			if (!_edgeTriggered)
+				return (0);
+			received += bytes;
+			continue ;
+		}
+
+		if (bytes == -1 && errno == EINTR)
+			continue ;
+		if (bytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return (0);
+		return (-1);
+	}
+}
+
+/******************************************************************************/
+/*							CONNECTIONS MANAGEMENT							  */
+/******************************************************************************/
+
+/*
+Adds the socket of a new user to the epoll instance
+- Success: returns 0
+- Error: returns 1.
+*/
+int	EpollReactor::addConnection(User &user)
+{
+	struct epoll_event	ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = _epollEvents;
+	ev.data.fd = user.getSocket();
+	if (epoll_ctl(_epollfd, EPOLL_CTL_ADD, user.getSocket(), &ev) == -1)
+		return (1);
+	return (0);
+}
+
+/*
+Gives the user a last chance to receive its queue,
+then closes its socket, which also removes it from epoll.
+*/
+void	EpollReactor::removeConnection(User &user)
+{
+	user.sendPending();
+	close(user.getSocket());
+}
+
+/*
+Writes the outbound queue of a user and keeps EPOLLOUT
+armed only while some bytes are still waiting
+- Success: returns 0
+- Error: returns 1.
+*/
+int	EpollReactor::flush(User &user)
+{
+	struct epoll_event	ev;
+	int					status;
+
+	status = user.sendPending();
+	if (status == -1)
+		return (1);
+
+	if ((status == 1) != user.isWriteArmed()) {
+		memset(&ev, 0, sizeof(ev));
+		ev.events = (status == 1) ? _epollEvents | EPOLLOUT : _epollEvents;
+		ev.data.fd = user.getSocket();
+		if (epoll_ctl(_epollfd, EPOLL_CTL_MOD, user.getSocket(), &ev) == -1)
+			return (1);
+		user.setWriteArmed(status == 1);
+	}
+	return (0);
+}
@@ -0,0 +1,90 @@
+#include "InputBuffer.hpp"
+#include "Metrics.hpp"
+
+#include <algorithm>
+
+InputBuffer::InputBuffer() : _start(0), _scan(0), _end(0) {}
+
+InputBuffer::~InputBuffer() {}
+
+/* Copies received bytes at the end of the buffer */
+void	InputBuffer::append(const char *data, size_t length)
+{
+	memcpy(reserve(length), data, length);
+	commit(length);
+}
+
+/*
+Makes room for length more bytes and returns where to write them,
+so that a socket can be read directly into the buffer.
+*/
+char	*InputBuffer::reserve(size_t length)
+{
+	if (_data.size() < _end + length)
+		_data.resize(_end + length);
+	return (&_data[0] + _end);
+}
+
+/* Accounts for bytes written in the room given by reserve */
+void	InputBuffer::commit(size_t length)
+{
+	_end += length;
+	g_bytesReceivedTotal.add(length);
+}
+
+/*
+Gives the next complete line, without its '\n'.
+The search resumes where the previous one stopped,
+so a line arriving in pieces is scanned only once.
+An unfinished line is cut at MESSAGE_LENGTH_MAX, the bytes past it
+are dropped, and the line is given truncated once its '\n' comes
+- Line available: returns true,
+- Nothing complete yet: returns false.
+*/
+bool	InputBuffer::nextLine(const char *&line, size_t &length)
+{
+	const char	*base = _data.empty() ? NULL : &_data[0];
+	const char	*newline;
+
+	if (_scan == _end)
+		return (false);
+
+	newline = static_cast<const char *>(memchr(base + _scan, '\n', _end - _scan));
+	if (!newline) {
+		if (_end - _start > MESSAGE_LENGTH_MAX)
+			_end = _start + MESSAGE_LENGTH_MAX;
+		_scan = _end;
+		return (false);
+	}
+
+	line = base + _start;
+	length = std::min<size_t>(newline - line, MESSAGE_LENGTH_MAX - 1);
+	_start = newline - base + 1;
+	_scan = _start;
+	return (true);
+}
+
+/*
+Gives the bytes appended since the last search for a line:
+before handleInput reads the lines, what the last read brought.
+*/
+void	InputBuffer::unscanned(const char *&data, size_t &length) const
+{
+	data = _data.empty() ? NULL : &_data[0] + _scan;
+	length = _end - _scan;
+}
+
+/* Drops the lines already read, moving the unfinished one to the front */
+void	InputBuffer::compact()
+{
+	if (_start == 0)
+		return ;
+
+	if (_start < _end)
+		memmove(&_data[0], &_data[0] + _start, _end - _start);
+	_end -= _start;
+	_scan -= _start;
+	_start = 0;
+}
+
+size_t	InputBuffer::size() const { return (_end - _start); }
@@ -0,0 +1,261 @@
+#include "Logger.hpp"
+
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <signal.h>
+
+/******************************************************************************/
+/*									RING									  */
+/******************************************************************************/
+
+/*
+Bounded queue of slots with a sequence number each (Vyukov's algorithm):
+a producer claims the slot of the enqueue position when its sequence
+equals the position, and publishes it by setting it to position + 1;
+the writer frees it by setting it to position + LOG_RING_SLOTS.
+*/
+namespace {
+
+	struct Slot {
+		size_t			sequence;
+		int				level;
+		struct timespec	time;
+		size_t			length;
+		char			data[LOG_LINE_MAX];
+	};
+
+	Slot			g_ring[LOG_RING_SLOTS];
+	size_t			g_enqueue = 0;
+	size_t			g_dequeue = 0;
+	unsigned long	g_dropped = 0;
+
+	const char		*g_levels[] = {"DEBUG", "INFO ", "WARN ", "ERROR"};
+
+}
+
+int			Logger::_level = LEVEL_OFF;
+int			Logger::_fd = STDERR_FILENO;
+bool		Logger::_running = false;
+bool		Logger::_stop = false;
+pthread_t	Logger::_thread;
+
+/******************************************************************************/
+/*									LOGGER									  */
+/******************************************************************************/
+
+/*
+Opens the log file (standard error when path is empty)
+and starts the writer thread, throws if either fails.
+The writer doesn't take SIGINT, which must interrupt the server thread.
+*/
+void	Logger::start(int level, std::string const &path)
+{
+	sigset_t	blocked;
+	sigset_t	previous;
+	int			status;
+
+	for (size_t i = 0; i < LOG_RING_SLOTS; ++i)
+		g_ring[i].sequence = i;
+
+	if (!path.empty()) {
+		_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+		if (_fd == -1)
+			throw std::runtime_error("Error: cannot open log file " + path);
+	}
+	_stop = false;
+	sigemptyset(&blocked);
+	sigaddset(&blocked, SIGINT);
+	sigaddset(&blocked, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+	status = pthread_create(&_thread, NULL, &Logger::writer, NULL);
+	pthread_sigmask(SIG_SETMASK, &previous, NULL);
+	if (status != 0)
+		throw std::runtime_error("Error: cannot start the log writer");
+	_running = true;
+	__atomic_store_n(&_level, level, __ATOMIC_RELEASE);
+}
+
+/* Stops logging, the writer thread drains the ring before exiting */
+void	Logger::stop()
+{
+	if (!_running)
+		return ;
+
+	__atomic_store_n(&_level, LEVEL_OFF, __ATOMIC_RELEASE);
+	__atomic_store_n(&_stop, true, __ATOMIC_RELEASE);
+	pthread_join(_thread, NULL);
+	_running = false;
+	if (_fd != STDERR_FILENO)
+		close(_fd);
+	_fd = STDERR_FILENO;
+}
+
+/* Copies a line into a free slot, or drops it when the ring is full */
+void	Logger::publish(int level, struct timespec const &time, const char *data, size_t length)
+{
+	size_t	pos = __atomic_load_n(&g_enqueue, __ATOMIC_RELAXED);
+	Slot	*slot;
+
+	for (;;) {
+		slot = &g_ring[pos & (LOG_RING_SLOTS - 1)];
+		size_t	sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+		long	diff = static_cast<long>(sequence - pos);
+
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&g_enqueue, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break ;
+		} else if (diff < 0) {
+			__atomic_add_fetch(&g_dropped, 1, __ATOMIC_RELAXED);
+			return ;
+		} else {
+			pos = __atomic_load_n(&g_enqueue, __ATOMIC_RELAXED);
+		}
+	}
+
+	slot->level = level;
+	slot->time = time;
+	slot->length = length;
+	memcpy(slot->data, data, length);
+	__atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+}
+
+unsigned long	Logger::dropped() { return (__atomic_load_n(&g_dropped, __ATOMIC_RELAXED)); }
+
+/* Converts a --log-level value, -1 when unknown */
+int	Logger::parseLevel(std::string const &name)
+{
+	if (name == "debug")
+		return (LEVEL_DEBUG);
+	if (name == "info")
+		return (LEVEL_INFO);
+	if (name == "warn")
+		return (LEVEL_WARN);
+	if (name == "error")
+		return (LEVEL_ERROR);
+	if (name == "off")
+		return (LEVEL_OFF);
+	return (-1);
+}
+
+/******************************************************************************/
+/*									WRITER									  */
+/******************************************************************************/
+
+/* Formats every published line into the batch, returns how many */
+size_t	Logger::drain(std::string &batch)
+{
+	size_t	count = 0;
+	char	stamp[32];
+	struct tm	tm;
+
+	for (;;) {
+		Slot	&slot = g_ring[g_dequeue & (LOG_RING_SLOTS - 1)];
+		size_t	length;
+
+		if (__atomic_load_n(&slot.sequence, __ATOMIC_ACQUIRE) != g_dequeue + 1)
+			break ;
+		length = slot.length;
+
+		localtime_r(&slot.time.tv_sec, &tm);
+		strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+		batch.append(stamp);
+		snprintf(stamp, sizeof(stamp), ".%03ld ", slot.time.tv_nsec / 1000000);
+		batch.append(stamp);
+		batch.append(g_levels[slot.level]);
+		batch.append(" ");
+		while (length && (slot.data[length - 1] == '\n' || slot.data[length - 1] == '\r'))
+			--length;
+		batch.append(slot.data, length);
+		batch.append("\n");
+
+		__atomic_store_n(&slot.sequence, g_dequeue + LOG_RING_SLOTS, __ATOMIC_RELEASE);
+		++g_dequeue;
+		++count;
+	}
+	return (count);
+}
+
+/* Writes the published lines in one call per interval until stopped */
+void	*Logger::writer(void *)
+{
+	std::string		batch;
+	unsigned long	reported = 0;
+	bool			stopping;
+
+	for (;;) {
+		stopping = __atomic_load_n(&_stop, __ATOMIC_ACQUIRE);
+		batch.clear();
+		drain(batch);
+		if (dropped() != reported) {
+			char	line[64];
+
+			snprintf(line, sizeof(line), "%lu log lines dropped\n", dropped() - reported);
+			batch.append(line);
+			reported = dropped();
+		}
+		for (size_t done = 0; done < batch.length(); ) {
+			ssize_t	n = ::write(_fd, batch.data() + done, batch.length() - done);
+
+			if (n <= 0)
+				break ;
+			done += n;
+		}
+		if (stopping)
+			return (NULL);
+		usleep(LOG_FLUSH_INTERVAL);
+	}
+}
+
+/******************************************************************************/
+/*									LINES									  */
+/******************************************************************************/
+
+/* The coarse clock is read from the vDSO in a few nanoseconds */
+LogLine::LogLine(int level) : _level(level), _length(0)
+{
+	clock_gettime(CLOCK_REALTIME_COARSE, &_time);
+}
+
+LogLine::~LogLine()
+{
+	Logger::publish(_level, _time, _data, _length);
+}
+
+/* Appends what fits in the line, the rest is cut */
+LogLine	&LogLine::write(const char *data, size_t length)
+{
+	if (length > LOG_LINE_MAX - _length)
+		length = LOG_LINE_MAX - _length;
+	memcpy(_data + _length, data, length);
+	_length += length;
+	return (*this);
+}
+
+LogLine	&LogLine::operator<<(const char *str) { return (write(str, strlen(str))); }
+LogLine	&LogLine::operator<<(std::string const &str) { return (write(str.data(), str.length())); }
+LogLine	&LogLine::operator<<(int n) { return (*this << static_cast<long>(n)); }
+LogLine	&LogLine::operator<<(unsigned int n) { return (*this << static_cast<unsigned long>(n)); }
+
+LogLine	&LogLine::operator<<(long n)
+{
+	if (n < 0) {
+		write("-", 1);
+		return (*this << static_cast<unsigned long>(-(n + 1)) + 1);
+	}
+	return (*this << static_cast<unsigned long>(n));
+}
+
+LogLine	&LogLine::operator<<(unsigned long n)
+{
+	char	digits[20];
+	size_t	i = sizeof(digits);
+
+	do {
+		digits[--i] = '0' + n % 10;
+		n /= 10;
+	} while (n);
+	return (write(digits + i, sizeof(digits) - i));
+}
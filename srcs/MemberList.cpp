@@ -0,0 +1,95 @@
+#include "MemberList.hpp"
+#include "User.hpp"
+#include "ObjectPool.hpp"
+
+static ObjectPool	g_membershipPool(sizeof(Membership), MEMBERSHIP_POOL_SLAB);
+
+void	*Membership::operator new(size_t size) { return (g_membershipPool.allocate(size)); }
+void	Membership::operator delete(void *ptr, size_t size) { g_membershipPool.release(ptr, size); }
+
+MemberList::MemberList() {}
+
+/*
+Frees the records still on the list without touching their users:
+only reached at shutdown, once the users are gone,
+since a channel is deleted as soon as it is empty.
+*/
+MemberList::~MemberList()
+{
+	for (size_t i = 0; i < _members.size(); ++i)
+		delete _members[i];
+}
+
+/*
+Creates the membership record of a user and links it on both sides:
+- Added: returns the record,
+- Already a member: returns NULL.
+*/
+Membership	*MemberList::add(User *user, Channel *channel, unsigned char modes)
+{
+	Membership	*membership;
+
+	if (_index.contains(user))
+		return (NULL);
+
+	membership = new Membership;
+	membership->user = user;
+	membership->channel = channel;
+	membership->modes = modes;
+	membership->channelSlot = _members.size();
+	_index.insert(user, membership->channelSlot);
+	_members.push_back(membership);
+	user->linkMembership(membership);
+	return (membership);
+}
+
+/*
+Unlinks a member from both sides, moving the last member into its slot,
+then frees its record:
+- Removed: returns true,
+- Not a member: returns false.
+*/
+bool	MemberList::remove(User *user)
+{
+	size_t		pos;
+	Membership	*membership;
+
+	if (!_index.find(user, pos))
+		return (false);
+
+	membership = _members[pos];
+	_index.erase(user);
+	if (pos != _members.size() - 1) {
+		_members[pos] = _members.back();
+		_members[pos]->channelSlot = pos;
+		_index.insert(_members[pos]->user, pos);
+	}
+	_members.pop_back();
+	user->unlinkMembership(membership);
+	delete membership;
+	return (true);
+}
+
+/* Gets the membership of a user, NULL if not on the channel */
+Membership	*MemberList::find(User *user)
+{
+	size_t	pos;
+
+	if (!_index.find(user, pos))
+		return (NULL);
+	return (_members[pos]);
+}
+
+Membership const	*MemberList::find(User *user) const
+{
+	size_t	pos;
+
+	if (!_index.find(user, pos))
+		return (NULL);
+	return (_members[pos]);
+}
+
+bool				MemberList::contains(User *user) const { return (_index.contains(user)); }
+size_t				MemberList::size() const { return (_members.size()); }
+bool				MemberList::empty() const { return (_members.empty()); }
+Membership const	&MemberList::operator[](size_t i) const { return (*_members[i]); }
@@ -0,0 +1,64 @@
+#include "Message.hpp"
+
+/* Moves p past the spaces separating two tokens */
+static const char	*skipSpaces(const char *p, const char *end)
+{
+	while (p < end && *p == ' ')
+		++p;
+	return (p);
+}
+
+/* Moves p to the end of the current token */
+static const char	*skipToken(const char *p, const char *end)
+{
+	while (p < end && *p != ' ')
+		++p;
+	return (p);
+}
+
+/*
+Parses a line, without its '\n', in a single pass.
+A trailing '\r' is dropped, and runs of spaces are accepted
+between tokens, as sent by some clients.
+- Success: returns true,
+- Empty line or no command: returns false.
+*/
+bool	parseMessage(const char *line, size_t length, Message &message)
+{
+	const char	*end = line + length;
+	const char	*p;
+	const char	*token;
+
+	while (end > line && (end[-1] == '\r' || end[-1] == '\n'))
+		--end;
+
+	message = Message();
+	p = skipSpaces(line, end);
+	if (p < end && *p == ':') {
+		token = ++p;
+		p = skipToken(p, end);
+		message.prefix = Span(token, p);
+		p = skipSpaces(p, end);
+	}
+
+	token = p;
+	p = skipToken(p, end);
+	message.command = Span(token, p);
+	if (message.command.empty())
+		return (false);
+
+	while ((p = skipSpaces(p, end)) < end) {
+		if (*p == ':' || message.paramCount == MESSAGE_PARAMS_MAX - 1) {
+			if (*p == ':')
+				++p;
+			message.trailing = Span(p, end);
+			message.hasTrailing = true;
+			message.params[message.paramCount++] = message.trailing;
+			break ;
+		}
+		token = p;
+		p = skipToken(p, end);
+		message.params[message.paramCount++] = Span(token, p);
+	}
+	return (true);
+}
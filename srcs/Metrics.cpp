@@ -0,0 +1,320 @@
+#include "Metrics.hpp"
+
+#include <stdexcept>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/******************************************************************************/
+/*									REGISTRY								  */
+/******************************************************************************/
+
+/* Built on first use, so that metrics of any file can register */
+static std::vector<Metric *>	&registry()
+{
+	static std::vector<Metric *>	metrics;
+
+	return (metrics);
+}
+
+/* Renders every registered metric in the Prometheus text format */
+std::string	renderMetrics()
+{
+	std::string	out;
+
+	for (size_t i = 0; i < registry().size(); ++i)
+		registry()[i]->render(out);
+	return (out);
+}
+
+/******************************************************************************/
+/*									METRICS									  */
+/******************************************************************************/
+
+Metric::Metric(const char *name, const char *help) : _name(name), _help(help)
+{
+	registry().push_back(this);
+}
+
+Metric::~Metric() {}
+
+void	Metric::header(std::string &out, const char *type) const
+{
+	out.append("# HELP ").append(_name).append(" ").append(_help).append("\n");
+	out.append("# TYPE ").append(_name).append(" ").append(type).append("\n");
+}
+
+void	Metric::sample(std::string &out, const char *suffix, const char *labels, unsigned long value) const
+{
+	char	number[24];
+
+	snprintf(number, sizeof(number), " %lu\n", value);
+	out.append(_name).append(suffix).append(labels).append(number);
+}
+
+Counter::Counter(const char *name, const char *help) : Metric(name, help), _value(0) {}
+
+void	Counter::render(std::string &out) const
+{
+	header(out, "counter");
+	sample(out, "", "", value());
+}
+
+Gauge::Gauge(const char *name, const char *help) : Metric(name, help), _value(0) {}
+
+void	Gauge::render(std::string &out) const
+{
+	char	number[24];
+
+	header(out, "gauge");
+	snprintf(number, sizeof(number), " %ld\n", value());
+	out.append(_name).append(number);
+}
+
+/* bounds must be sorted and outlive the histogram */
+Histogram::Histogram(const char *name, const char *help, unsigned long const *bounds, size_t count) :
+	Metric(name, help),
+	_bounds(bounds),
+	_count(count),
+	_buckets(new unsigned long[count + 1]()),
+	_sum(0)
+{}
+
+Histogram::~Histogram() { delete[] _buckets; }
+
+/* Counts the value in the first bucket holding it, the last one being +Inf */
+void	Histogram::observe(unsigned long value)
+{
+	size_t	i = 0;
+
+	while (i < _count && value > _bounds[i])
+		++i;
+	__atomic_add_fetch(&_buckets[i], 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&_sum, value, __ATOMIC_RELAXED);
+}
+
+/* Prometheus buckets are cumulative */
+void	Histogram::render(std::string &out) const
+{
+	unsigned long	total = 0;
+	char			labels[40];
+
+	header(out, "histogram");
+	for (size_t i = 0; i < _count; ++i) {
+		total += __atomic_load_n(&_buckets[i], __ATOMIC_RELAXED);
+		snprintf(labels, sizeof(labels), "{le=\"%lu\"}", _bounds[i]);
+		sample(out, "_bucket", labels, total);
+	}
+	total += __atomic_load_n(&_buckets[_count], __ATOMIC_RELAXED);
+	sample(out, "_bucket", "{le=\"+Inf\"}", total);
+	sample(out, "_sum", "", __atomic_load_n(&_sum, __ATOMIC_RELAXED));
+	sample(out, "_count", "", total);
+}
+
+LatencyHistogram::LatencyHistogram() : _count(0), _sum(0)
+{
+	memset(_buckets, 0, sizeof(_buckets));
+}
+
+/*
+Values under 2^LATENCY_SUB_BITS have a bucket each, above it the
+bucket is the exponent followed by the bits after the leading one.
+*/
+static size_t	latencyBucket(unsigned long value)
+{
+	unsigned	exponent;
+
+	if (value < (1UL << LATENCY_SUB_BITS))
+		return (value);
+	exponent = 63 - __builtin_clzl(value);
+	if (exponent > LATENCY_EXPONENT_MAX)
+		return (LATENCY_BUCKETS - 1);
+	return (((exponent - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS)
+		| ((value >> (exponent - LATENCY_SUB_BITS)) & ((1UL << LATENCY_SUB_BITS) - 1)));
+}
+
+/* Highest value counted in a bucket */
+static unsigned long	latencyBucketMax(size_t bucket)
+{
+	unsigned		exponent;
+	unsigned long	sub;
+
+	if (bucket < (1UL << LATENCY_SUB_BITS))
+		return (bucket);
+	exponent = (bucket >> LATENCY_SUB_BITS) + LATENCY_SUB_BITS - 1;
+	sub = bucket & ((1UL << LATENCY_SUB_BITS) - 1);
+	return ((((1UL << LATENCY_SUB_BITS) + sub + 1) << (exponent - LATENCY_SUB_BITS)) - 1);
+}
+
+void	LatencyHistogram::record(unsigned long nanoseconds)
+{
+	__atomic_add_fetch(&_buckets[latencyBucket(nanoseconds)], 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&_count, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&_sum, nanoseconds, __ATOMIC_RELAXED);
+}
+
+/* Highest value of the bucket where the q fraction of the counts is reached */
+unsigned long	LatencyHistogram::quantile(double q) const
+{
+	unsigned long const	rank = static_cast<unsigned long>(q * count() + 0.5);
+	unsigned long		seen = 0;
+
+	for (size_t i = 0; i < LATENCY_BUCKETS; ++i) {
+		seen += __atomic_load_n(&_buckets[i], __ATOMIC_RELAXED);
+		if (seen && seen >= rank)
+			return (latencyBucketMax(i));
+	}
+	return (0);
+}
+
+/* Renders the quantiles, sum and count of a summary, labels being "" or name="value" */
+void	Metric::summary(std::string &out, const char *labels, LatencyHistogram const &latency) const
+{
+	static double const	quantiles[] = {0.5, 0.99, 0.999};
+	char				line[96];
+
+	for (size_t i = 0; i < sizeof(quantiles) / sizeof(*quantiles); ++i) {
+		snprintf(line, sizeof(line), "{%s%squantile=\"%g\"} %.9f\n", labels, *labels ? "," : "",
+			quantiles[i], latency.quantile(quantiles[i]) / 1e9);
+		out.append(_name).append(line);
+	}
+	snprintf(line, sizeof(line), "%s%s%s %.9f\n", *labels ? "{" : "", labels, *labels ? "}" : "", latency.sum() / 1e9);
+	out.append(_name).append("_sum").append(line);
+	snprintf(line, sizeof(line), "%s%s%s %lu\n", *labels ? "{" : "", labels, *labels ? "}" : "", latency.count());
+	out.append(_name).append("_count").append(line);
+}
+
+Summary::Summary(const char *name, const char *help) : Metric(name, help) {}
+
+void	Summary::render(std::string &out) const
+{
+	header(out, "summary");
+	summary(out, "", _latency);
+}
+
+/******************************************************************************/
+/*								SERVER METRICS								  */
+/******************************************************************************/
+
+static unsigned long const	g_fanoutBounds[] = {1, 2, 5, 10, 50, 100, 500, 1000, 5000, 10000};
+
+Counter		g_connectionsTotal("irc_connections_total", "Connections accepted.");
+Gauge		g_users("irc_users", "Connected users, registered or not.");
+Gauge		g_channels("irc_channels", "Existing channels.");
+Counter		g_commandsTotal("irc_commands_total", "Command lines executed.");
+Counter		g_unknownCommandsTotal("irc_unknown_commands_total", "Command lines with an unknown command.");
+Counter		g_bytesReceivedTotal("irc_bytes_received_total", "Bytes read from client sockets.");
+Counter		g_bytesSentTotal("irc_bytes_sent_total", "Bytes written to client sockets.");
+Counter		g_messagesQueuedTotal("irc_messages_queued_total", "Lines queued for a user.");
+Counter		g_sendFailuresTotal("irc_send_failures_total", "Lines dropped because their user was closing.");
+Histogram	g_fanoutRecipients("irc_fanout_recipients", "Recipients of a channel or neighbour broadcast.",
+	g_fanoutBounds, sizeof(g_fanoutBounds) / sizeof(*g_fanoutBounds));
+Gauge		g_loopLag("irc_loop_lag_nanoseconds", "Time from the reactor waking up to the end of the last event-loop iteration.");
+Summary		g_loopLagSeconds("irc_loop_lag_seconds", "Time from the reactor waking up to the end of an event-loop iteration.");
+
+/******************************************************************************/
+/*									EXPORTER								  */
+/******************************************************************************/
+
+int			MetricsExporter::_fd = -1;
+bool		MetricsExporter::_stop = false;
+pthread_t	MetricsExporter::_thread;
+std::string	MetricsExporter::_path;
+
+/*
+Binds the socket, replacing a stale one, and starts serving it
+from a thread which leaves SIGINT to the server thread
+*/
+void	MetricsExporter::start(std::string const &path)
+{
+	struct sockaddr_un	addr;
+	sigset_t			blocked;
+	sigset_t			previous;
+	int					status;
+
+	if (path.length() >= sizeof(addr.sun_path))
+		throw std::runtime_error("Error: metrics socket path too long");
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	memcpy(addr.sun_path, path.c_str(), path.length());
+	unlink(path.c_str());
+
+	_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (_fd == -1 || bind(_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == -1 || listen(_fd, 16) == -1) {
+		if (_fd != -1)
+			close(_fd);
+		_fd = -1;
+		throw std::runtime_error("Error: cannot listen on metrics socket " + path);
+	}
+	_path = path;
+	_stop = false;
+	sigemptyset(&blocked);
+	sigaddset(&blocked, SIGINT);
+	sigaddset(&blocked, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+	status = pthread_create(&_thread, NULL, &MetricsExporter::serve, NULL);
+	pthread_sigmask(SIG_SETMASK, &previous, NULL);
+	if (status != 0) {
+		close(_fd);
+		_fd = -1;
+		throw std::runtime_error("Error: cannot start the metrics exporter");
+	}
+}
+
+void	MetricsExporter::stop()
+{
+	if (_fd == -1)
+		return ;
+
+	__atomic_store_n(&_stop, true, __ATOMIC_RELEASE);
+	pthread_join(_thread, NULL);
+	close(_fd);
+	unlink(_path.c_str());
+	_fd = -1;
+}
+
+/*
+Answers one scrape per connection: the request, if any comes within
+a short delay, is read and ignored, then the metrics are written.
+The accept wait times out regularly to notice stop().
+*/
+void	*MetricsExporter::serve(void *)
+{
+	struct pollfd	pfd;
+	char			request[1024];
+
+	while (!__atomic_load_n(&_stop, __ATOMIC_ACQUIRE)) {
+		pfd.fd = _fd;
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, METRICS_POLL_TIMEOUT) <= 0)
+			continue ;
+
+		int	client = accept(_fd, NULL, NULL);
+		if (client == -1)
+			continue ;
+
+		pfd.fd = client;
+		if (poll(&pfd, 1, METRICS_POLL_TIMEOUT) > 0 && read(client, request, sizeof(request)) == -1) {
+			close(client);
+			continue ;
+		}
+
+		std::string	body = renderMetrics();
+		std::string	response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n\r\n" + body;
+
+		for (size_t done = 0; done < response.length(); ) {
+			ssize_t	n = send(client, response.data() + done, response.length() - done, MSG_NOSIGNAL);
+
+			if (n <= 0)
+				break ;
+			done += n;
+		}
+		close(client);
+	}
+	return (NULL);
+}
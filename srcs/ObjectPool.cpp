@@ -0,0 +1,82 @@
+#include "ObjectPool.hpp"
+
+#include <new>
+#include <algorithm>
+
+/******************************************************************************/
+/*						CONSTRUCTORS & DESTRUCTORS							  */
+/******************************************************************************/
+
+/* Objects are rounded up to hold a free list link and keep pointer alignment */
+ObjectPool::ObjectPool(size_t objectSize, size_t objectsPerSlab) :
+	_objectSize((std::max(objectSize, sizeof(void *)) + sizeof(void *) - 1) & ~(sizeof(void *) - 1)),
+	_objectsPerSlab(objectsPerSlab),
+	_freeList(NULL),
+	_used(0)
+{}
+
+ObjectPool::~ObjectPool()
+{
+	for (size_t i = 0; i < _slabs.size(); ++i)
+		::operator delete(_slabs[i]);
+}
+
+/******************************************************************************/
+/*								ALLOCATION									  */
+/******************************************************************************/
+
+/* Cuts a new slab and chains its objects into the free list */
+void	ObjectPool::grow()
+{
+	char	*slab = static_cast<char *>(::operator new(_objectSize * _objectsPerSlab));
+
+	try {
+		_slabs.push_back(slab);
+	} catch (...) {
+		::operator delete(slab);
+		throw ;
+	}
+	for (size_t i = _objectsPerSlab; i > 0; --i) {
+		void	**object = reinterpret_cast<void **>(slab + (i - 1) * _objectSize);
+
+		*object = _freeList;
+		_freeList = object;
+	}
+}
+
+/*
+Takes an object from the free list, cutting a new slab when it is empty.
+A size other than the pool's (a derived class) goes to the heap.
+*/
+void	*ObjectPool::allocate(size_t size)
+{
+	void	*object;
+
+	if (size > _objectSize)
+		return (::operator new(size));
+
+	if (!_freeList)
+		grow();
+	object = _freeList;
+	_freeList = *static_cast<void **>(object);
+	++_used;
+	return (object);
+}
+
+/* Gives an object back, size being the one it was allocated with */
+void	ObjectPool::release(void *ptr, size_t size)
+{
+	if (!ptr)
+		return ;
+
+	if (size > _objectSize) {
+		::operator delete(ptr);
+		return ;
+	}
+	*static_cast<void **>(ptr) = _freeList;
+	_freeList = ptr;
+	--_used;
+}
+
+size_t	ObjectPool::capacity() const { return (_slabs.size() * _objectsPerSlab); }
+size_t	ObjectPool::used() const { return (_used); }
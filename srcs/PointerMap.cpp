@@ -0,0 +1,119 @@
+#include "PointerMap.hpp"
+
+# define POINTERMAP_MIN_SLOTS 8
+
+PointerMap::PointerMap() : _size(0) {}
+
+PointerMap::~PointerMap() {}
+
+/*
+Home slot of a key: Fibonacci hashing of the address,
+whose low bits are always zero because of alignment.
+*/
+size_t	PointerMap::slotOf(const void *key) const
+{
+	uint64_t	hash = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(key)) * 0x9E3779B97F4A7C15ULL;
+
+	return (static_cast<size_t>(hash >> 32) & (_slots.size() - 1));
+}
+
+/* Doubles the table and places every key again */
+void	PointerMap::grow()
+{
+	std::vector<Slot>	old;
+	Slot				empty = {NULL, 0};
+
+	old.swap(_slots);
+	_slots.assign(old.empty() ? POINTERMAP_MIN_SLOTS : old.size() * 2, empty);
+	_size = 0;
+	for (size_t i = 0; i < old.size(); ++i) {
+		if (old[i].key)
+			insert(old[i].key, old[i].value);
+	}
+}
+
+/* Adds a key, or updates its value when it is already there */
+void	PointerMap::insert(const void *key, size_t value)
+{
+	size_t	i;
+
+	if ((_size + 1) * 2 > _slots.size())
+		grow();
+
+	for (i = slotOf(key); _slots[i].key; i = (i + 1) & (_slots.size() - 1)) {
+		if (_slots[i].key == key) {
+			_slots[i].value = value;
+			return ;
+		}
+	}
+	_slots[i].key = key;
+	_slots[i].value = value;
+	++_size;
+}
+
+/*
+Looks a key up:
+- Found: returns true and sets value,
+- Missing: returns false.
+*/
+bool	PointerMap::find(const void *key, size_t &value) const
+{
+	if (_slots.empty())
+		return (false);
+
+	for (size_t i = slotOf(key); _slots[i].key; i = (i + 1) & (_slots.size() - 1)) {
+		if (_slots[i].key == key) {
+			value = _slots[i].value;
+			return (true);
+		}
+	}
+	return (false);
+}
+
+bool	PointerMap::contains(const void *key) const
+{
+	size_t	value;
+
+	return (find(key, value));
+}
+
+/*
+Removes a key, then moves back the keys of the same probe run
+that were displaced past the freed slot.
+- Removed: returns true,
+- Missing: returns false.
+*/
+bool	PointerMap::erase(const void *key)
+{
+	size_t	mask = _slots.size() - 1;
+	size_t	hole;
+
+	if (_slots.empty())
+		return (false);
+
+	for (hole = slotOf(key); _slots[hole].key != key; hole = (hole + 1) & mask) {
+		if (!_slots[hole].key)
+			return (false);
+	}
+
+	for (size_t i = (hole + 1) & mask; _slots[i].key; i = (i + 1) & mask) {
+		size_t	home = slotOf(_slots[i].key);
+
+		// the key at i may fill the hole unless its home lies in (hole, i]
+		if (((i - home) & mask) >= ((i - hole) & mask)) {
+			_slots[hole] = _slots[i];
+			hole = i;
+		}
+	}
+	_slots[hole].key = NULL;
+	--_size;
+	return (true);
+}
+
+void	PointerMap::clear()
+{
+	_slots.clear();
+	_size = 0;
+}
+
+size_t	PointerMap::size() const { return (_size); }
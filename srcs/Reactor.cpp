@@ -0,0 +1,65 @@
+#include "Reactor.hpp"
+#include "EpollReactor.hpp"
+#include "UringReactor.hpp"
+#include "ShardedReactor.hpp"
+#include "ReplayReactor.hpp"
+#include "Server.hpp"
+
+/*
+Builds the backend selected by --backend, or the multi-reactor
+one when --reactors asks for more than one thread, falling back to epoll when io_uring can't be set up on this kernel.
+A --replay runs on the in-memory backend whatever the others ask.
+*/
+Reactor	*Reactor::create(Server &server, Config const &config)
+{
+	if (!config.replay.empty())
+		return (new ReplayReactor(server, config));
+	if (config.reactors > 1)
+		return (new ShardedReactor(server, config));
+	if (config.backend == "uring") {
+		try {
+			return (new UringReactor(server, config));
+		} catch (std::exception const &e) {
+			LOG_WARN << e.what() << ", falling back to epoll";
+		}
+	}
+	return (new EpollReactor(server, config));
+}
+
+/******************************************************************************/
+/*								ACCEPT RESERVE								  */
+/******************************************************************************/
+
+AcceptReserve::AcceptReserve() :
+	_fd(open("/dev/null", O_RDONLY | O_CLOEXEC)),
+	_refused(0),
+	_lastWarning(0)
+{}
+
+AcceptReserve::~AcceptReserve()
+{
+	if (_fd != -1)
+		close(_fd);
+}
+
+bool	AcceptReserve::shed(int socketServer)
+{
+	unsigned long const	now = monotonicNanoseconds();
+	int					socket;
+
+	if (_fd != -1)
+		close(_fd);
+	socket = accept4(socketServer, NULL, NULL, SOCK_CLOEXEC);
+	if (socket != -1) {
+		close(socket);
+		++_refused;
+	}
+	_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+	if (_refused && now - _lastWarning >= SHED_WARNING_INTERVAL) {
+		LOG_WARN << "out of file descriptors, " << _refused << " connections refused";
+		_refused = 0;
+		_lastWarning = now;
+	}
+	return (socket != -1);
+}
@@ -0,0 +1,127 @@
+#include "ReplayReactor.hpp"
+#include "Server.hpp"
+
+/******************************************************************************/
+/*						CONSTRUCTORS & DESTRUCTORS							  */
+/******************************************************************************/
+
+ReplayReactor::ReplayReactor(Server &server, Config const &config) :
+	_server(server),
+	_reader(config.replay),
+	_paced(config.replayPaced),
+	_hasRecord(false),
+	_replayTime(0),
+	_start(0),
+	_records(0),
+	_bytesIn(0),
+	_bytesOut(0)
+{}
+
+ReplayReactor::~ReplayReactor() {}
+
+/******************************************************************************/
+/*						       EVENTS MANAGEMENT     						  */
+/******************************************************************************/
+
+/* The listening socket is left alone, connections come from the capture */
+void	ReplayReactor::start(int socketServer)
+{
+	(void)socketServer;
+	_start = monotonicNanoseconds();
+	LOG_INFO << "replaying " << (_paced ? "at the recorded pacing" : "at full speed");
+}
+
+/*
+Replays up to REPLAY_BATCH records as one batch of events.
+With the recorded pacing, waits for the first record to be due
+and stops the batch at the first one that is not yet.
+*/
+int	ReplayReactor::poll()
+{
+	unsigned long	now;
+
+	if (!_hasRecord && !(_hasRecord = _reader.next(_record))) {
+		finish();
+		return (0);
+	}
+	if (_paced) {
+		now = monotonicNanoseconds();
+		if (_start + _record.time > now)
+			usleep((_start + _record.time - now) / 1000);
+	}
+	woke();
+
+	for (size_t n = 0; n < REPLAY_BATCH && _hasRecord; ++n) {
+		if (_paced && n && _start + _record.time > monotonicNanoseconds())
+			break ;
+		replay(_record);
+		_hasRecord = _reader.next(_record);
+	}
+	return (0);
+}
+
+/* Seconds since the capture started, as of the last record replayed */
+time_t	ReplayReactor::now() const { return (static_cast<time_t>(_replayTime / 1000000000UL)); }
+
+/* Applies a record to the server as the reactors do for socket events */
+void	ReplayReactor::replay(CaptureRecord const &record)
+{
+	User				*user = _server.findUserBySocket(record.socket);
+	struct sockaddr_in	addr;
+
+	++_records;
+	_replayTime = record.time;
+	if (record.event == CAPTURE_OPEN && !user && record.payload.size() == CAPTURE_ADDRESS_LENGTH) {
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		memcpy(&addr.sin_addr.s_addr, record.payload.data(), 4);
+		memcpy(&addr.sin_port, record.payload.data() + 4, 2);
+		_server.createUser(record.socket, addr);
+	} else if (record.event == CAPTURE_DATA && user) {
+		_bytesIn += record.payload.size();
+		user->getInput().append(record.payload.data(), record.payload.size());
+		_server.handleInput(*user, false);
+	} else if (record.event == CAPTURE_CLOSE && user)
+		_server.removeUser(*user, "Connection closed");
+}
+
+/* Reports the replay and stops the server like SIGINT does */
+void	ReplayReactor::finish()
+{
+	double const	seconds = (monotonicNanoseconds() - _start) / 1e9;
+	unsigned long	rate = 0;
+
+	if (seconds > 0)
+		rate = static_cast<unsigned long>(_records / seconds);
+	std::cerr << "replayed " << _records << " records, " << _bytesIn << " bytes in, "
+		<< _bytesOut << " bytes out in " << seconds << " s ("
+		<< rate << " records/s)" << std::endl;
+	g_end = true;
+}
+
+/******************************************************************************/
+/*							CONNECTIONS MANAGEMENT							  */
+/******************************************************************************/
+
+int	ReplayReactor::addConnection(User &user)
+{
+	(void)user;
+	return (0);
+}
+
+/* The sockets of a replay are not open, the queue left is dropped all the same */
+void	ReplayReactor::removeConnection(User &user) { flush(user); }
+
+/* Drops the whole queue, counting its bytes */
+int	ReplayReactor::flush(User &user)
+{
+	std::deque<SharedBuffer> const	&chunks = user.getSendQueue().getChunks();
+	size_t							bytes = 0;
+
+	for (size_t i = 0; i < chunks.size(); ++i)
+		bytes += chunks[i].length();
+	bytes -= user.getSendQueue().getOffset();
+	_bytesOut += bytes;
+	user.consumeOutput(bytes);
+	return (0);
+}
@@ -0,0 +1,64 @@
+#include "Reply.hpp"
+
+#include <string.h>
+
+/* Reserves a whole line and copies the template up to its first % */
+Reply::Reply(const char *format) :
+	_format(format),
+	_block(SharedBuffer::allocate(MESSAGE_LENGTH_MAX)),
+	_data(reinterpret_cast<char *>(_block + 1)),
+	_length(0)
+{
+	literal();
+}
+
+/* Gives the block back when the reply was never turned into a buffer */
+Reply::~Reply()
+{
+	if (_block)
+		SharedBuffer::release(_block);
+}
+
+/* Copies what fits before the room kept for CRLF */
+void	Reply::write(const char *data, size_t length)
+{
+	size_t	room = MESSAGE_LENGTH_MAX - 2 - _length;
+
+	if (length > room)
+		length = room;
+	memcpy(_data + _length, data, length);
+	_length += length;
+}
+
+/* Copies the template up to the next %, which is skipped */
+void	Reply::literal()
+{
+	const char	*end = strchr(_format, '%');
+
+	if (!end)
+		end = _format + strlen(_format);
+	write(_format, end - _format);
+	_format = *end ? end + 1 : end;
+}
+
+Reply	&Reply::arg(const char *data, size_t length)
+{
+	write(data, length);
+	literal();
+	return (*this);
+}
+
+Reply	&Reply::arg(const char *str) { return (arg(str, strlen(str))); }
+Reply	&Reply::arg(std::string const &str) { return (arg(str.data(), str.length())); }
+Reply	&Reply::arg(Span const &span) { return (arg(span.data, span.length)); }
+
+/* Ends the line, the reply can't be written to afterwards */
+SharedBuffer	Reply::buffer()
+{
+	SharedBuffer::Block	*block = _block;
+
+	memcpy(_data + _length, "\r\n", 2);
+	block->length = _length + 2;
+	_block = NULL;
+	return (SharedBuffer(block));
+}
@@ -0,0 +1,135 @@
+#include "SendQueue.hpp"
+#include "Metrics.hpp"
+
+#include <algorithm>
+
+SendQueue::SendQueue() : _offset(0), _size(0) {}
+
+SendQueue::~SendQueue() {}
+
+/*
+Appends a message to the queue.
+Nothing is written on the socket here, see send.
+*/
+void	SendQueue::push(SharedBuffer const &message)
+{
+	if (!message.empty()) {
+		_chunks.push_back(message);
+		_size += message.length();
+	}
+}
+
+/*
+Writes as much of the queue as the socket accepts,
+gathering up to SEND_IOV_MAX queued messages per sendmsg call:
+- Success: returns 0 when the queue is empty,
+- Would block: returns 1, the remaining bytes stay queued,
+- Error: returns -1, the queue is dropped since the connection is dead.
+*/
+int	SendQueue::send(int socket)
+{
+	struct iovec	iov[SEND_IOV_MAX];
+	struct msghdr	msg;
+	size_t			count;
+	ssize_t			sendBytes;
+
+	while (!_chunks.empty()) {
+		count = gather(iov, SEND_IOV_MAX);
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = count;
+		sendBytes = sendmsg(socket, &msg, MSG_NOSIGNAL);
+		if (sendBytes == -1) {
+			if (errno == EINTR)
+				continue ;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return (1);
+			clear();
+			return (-1);
+		}
+
+		consume(sendBytes);
+	}
+	return (0);
+}
+
+/*
+Points up to max iovecs at the unwritten bytes of the first messages,
+returns how many were filled.
+*/
+size_t	SendQueue::gather(struct iovec *iov, size_t max) const
+{
+	size_t	count = 0;
+
+	for (std::deque<SharedBuffer>::const_iterator it = _chunks.begin(); it != _chunks.end() && count < max; ++it) {
+		size_t	offset = (count == 0) ? _offset : 0;
+
+		iov[count].iov_base = const_cast<char *>(it->data()) + offset;
+		iov[count].iov_len = it->length() - offset;
+		++count;
+	}
+	return (count);
+}
+
+/* Drops bytes written on the socket from the front of the queue */
+void	SendQueue::consume(size_t bytes)
+{
+	g_bytesSentTotal.add(bytes);
+	_size -= std::min(bytes, _size);
+	while (bytes > 0 && !_chunks.empty()) {
+		size_t	left = _chunks.front().length() - _offset;
+
+		if (bytes < left) {
+			_offset += bytes;
+			return ;
+		}
+		bytes -= left;
+		_chunks.pop_front();
+		_offset = 0;
+	}
+}
+
+/*
+Moves the messages of a queue with nothing written yet
+at the end of this one, only their references are copied.
+*/
+void	SendQueue::append(SendQueue &other)
+{
+	if (_chunks.empty()) {
+		swap(other);
+		other.clear();
+		return ;
+	}
+
+	_chunks.insert(_chunks.end(), other._chunks.begin(), other._chunks.end());
+	_size += other._size;
+	other.clear();
+}
+
+/*
+Exchanges the content of two queues without copying the messages,
+which stay at the same address.
+*/
+void	SendQueue::swap(SendQueue &other)
+{
+	size_t	offset = _offset;
+	size_t	size = _size;
+
+	_chunks.swap(other._chunks);
+	_offset = other._offset;
+	other._offset = offset;
+	_size = other._size;
+	other._size = size;
+}
+
+void	SendQueue::clear()
+{
+	_chunks.clear();
+	_offset = 0;
+	_size = 0;
+}
+
+bool							SendQueue::empty() const { return (_chunks.empty()); }
+size_t							SendQueue::size() const { return (_size); }
+const std::deque<SharedBuffer>	&SendQueue::getChunks() const { return (_chunks); }
+const size_t					&SendQueue::getOffset() const { return (_offset); }
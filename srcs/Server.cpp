@@ -12,18 +12,34 @@ we're just using the parametrical one ? */
 Server::Server(void) {}
 
 /* Parametrical constructor :
-- Initializes the _port and _password members with the provided values.
+- Initializes the _port, _password and _config members with the provided values.
+- Opens the listening socket, shared with the other reactors
+when several of them are requested.
+*/
+Server::Server(std::string const &  port, std::string const & password, Config const & config):
+	_port(port),
+	_password(password),
+	_config(config),
+	_reactor(NULL),
+	_fanoutEpoch(0)
+{
+	_socketServer = openSocket(_config.reactors > 1);
+}
+
+/*
+Creates a non-blocking socket bound to the server port:
 - Gets information about network addresses for server listening.
 - Creates and binds a socket by looping through the results obtained.
+- With reusePort, several sockets can be bound to the same port
+and the kernel balances the incoming connections among them.
 */
-Server::Server(std::string const &  port, std::string const & password):
-	_port(port),
-	_password(password)
+int	Server::openSocket(bool reusePort) const
 {
 	struct addrinfo		hints;
 	struct addrinfo		*res;
 	struct addrinfo		*rp;
 	int					status;
+	int					sockfd;
 
 	// Define address info
 	memset(&hints, 0, sizeof(hints));
@@ -40,36 +56,36 @@ Server::Server(std::string const &  port, std::string const & password):
 	int reuse = 1;
 
 	for (rp = res; rp != NULL; rp = rp->ai_next) {
-		_socketServer = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
-		if (_socketServer == -1)
+		sockfd = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+		if (sockfd == -1)
 			continue ;
 
-		if (setsockopt(_socketServer, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) == -1) {
-			freeaddrinfo(res);
-			throw std::runtime_error("Error: cannot set option to socket");
-		}
-
-		if (fcntl(_socketServer, F_SETFL, O_NONBLOCK) == -1) {
+		if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) == -1
+			|| (reusePort && setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) == -1)
+			|| fcntl(sockfd, F_SETFL, O_NONBLOCK) == -1) {
+			close(sockfd);
 			freeaddrinfo(res);
 			throw std::runtime_error("Error: cannot set option to socket");
 		}
 
-		if (bind(_socketServer, rp->ai_addr, rp->ai_addrlen) == -1) {
+		if (bind(sockfd, rp->ai_addr, rp->ai_addrlen) == -1) {
+			close(sockfd);
 			freeaddrinfo(res);
 			throw std::runtime_error("Error: cannot bind");
 		} else {
 			freeaddrinfo(res);
-			return ;
+			return (sockfd);
 		}
 	}
 	
+	freeaddrinfo(res);
 	throw std::runtime_error("Error: cannot bind");
 }
 
 /* Destructor, ensuring sever's socket is closed */
 Server::~Server(void) {
 	close(_socketServer);
-	close(_epollfd);
+	delete _reactor;
 }
 
 /******************************************************************************/
@@ -79,235 +95,349 @@ Server::~Server(void) {
 /*
 Initializes and runs the server,
 handling events on file descriptors
-using the epoll instance
-and the handleEvents function.
+with the reactor selected by --backend,
+then flushing the replies of each batch.
 */
 void	Server::run(void)
 {
-	struct epoll_event	ev;
-	struct epoll_event	events[EVENTS_MAX];
-	int					nfds;
-
-
-	_epollfd = epoll_create1(0);
-	if (_epollfd == -1) {
-		throw std::runtime_error("Error: failed to create epoll");
-	}
+	int	status;
 
-	if (listen(_socketServer, EVENTS_MAX) < 0) {
+	if (listen(_socketServer, _config.backlog) < 0) {
 		throw std::runtime_error("Error: failed to listen on socket");
 	}
 
-	memset(&ev, 0, sizeof(ev));
-	ev.events = EPOLLIN;
-	ev.data.fd = _socketServer;
-	if (epoll_ctl(_epollfd, EPOLL_CTL_ADD, _socketServer, &ev) == -1) {
-		throw std::runtime_error("Error: failed to manage sockets");
-	}
+	_reactor = Reactor::create(*this, _config);
+	_reactor->start(_socketServer);
+	LOG_INFO << "listening on port " << _port << " with " << static_cast<unsigned long>(_config.reactors) << " reactor(s)";
 
 	while (1) {
-		nfds = epoll_wait(_epollfd, events, EVENTS_MAX, -1);
+		status = _reactor->poll();
 		if (g_end) {
+			flushPendingWrites();
 			quit();
 			return ;
 		}
 
-		if (nfds == -1) {
+		if (status == -1) {
 			throw std::runtime_error("Error: failed to received events");
 		}
-		
-		for (int n = 0; n < nfds; ++n) {
-			handleEvents(events[n].data.fd, events[n]);
-		}
+		flushPendingWrites();
+		recordLoopLag();
 	}
 }
 
 /*
-Handles events from epoll file descriptors,
-processes data received from clients, 
-manages user logins, 
-and executes pending commands from logged in users.
+Hands the server a reactor built by the caller, which it then owns,
+so that benchmarks drive the handlers without run() nor sockets.
 */
-void	Server::handleEvents(int fd, struct epoll_event event)
+void	Server::setReactor(Reactor *reactor)
 {
-	User	*user;
-
-	if (fd == _socketServer) { // First connection of a client
-		if (createUser())
-			return ;
+	delete _reactor;
+	_reactor = reactor;
+}
 
-	} else { // Handle events from clients
-		if (event.events != EPOLLIN)
-			return ;
+/*
+Measures the time from the reactor waking up to the end of the
+iteration, pending writes included: what a client whose events
+came in that batch waited for before its replies left.
+*/
+void	Server::recordLoopLag()
+{
+	unsigned long const	wakeTime = _reactor->takeWakeTime();
+	unsigned long		lag;
 
-		user = findUserBySocket(fd);
-		if (!user)
-			return ;
+	if (!wakeTime)
+		return ;
+	lag = monotonicNanoseconds() - wakeTime;
+	g_loopLag.set(lag);
+	g_loopLagSeconds.record(lag);
+}
 
-		std::string	buffer = receiveData(fd);
-		getCommands(*user, buffer);
+/*
+Called by the reactor once data from a client was
+appended to its buffer: executes the complete lines
+straight from the buffer, stopping as soon as the user
+is removed, then drops the connection if the peer closed it.
+*/
+void	Server::handleInput(User &user, bool closed)
+{
+	InputBuffer	&input = user.getInput();
+	const char	*line;
+	size_t		length;
 
-		if (user->getCommands().size() >= 1) {
-			execCommand(*user);
-		}
+	if (Capture::enabled()) {
+		input.unscanned(line, length);
+		Capture::data(user.getSocket(), line, length);
 	}
+	while (!user.isClosing() && input.nextLine(line, length))
+		execCommand(user, line, length);
+	input.compact();
+
+	if (closed)
+		removeUser(user, "Connection closed");
 }
 
 /*
-Receives data from a socket and returns it as a string,
-ensuring that the reception is complete up to the newline.
+Commands known by the server, with what execCommand checks
+before calling their handler:
+- the minimum number of parameters (ERR_NEEDMOREPARAMS),
+- whether the user must be registered or not yet (ERR_NOTREGISTERED,
+ERR_ALREADYREGISTRED),
+- the flood penalty in seconds, see --flood-limit.
+Entries are grouped by first letter, findCommand only
+compares the names of the group of the command.
 */
-std::string	Server::receiveData(int sockfd) const
+static Server::Command const	g_commands[] = {
+	{"INVITE",		&Server::inviteChannel,	2,	Server::REGISTRATION_REQUIRED,	1},
+	{"JOIN",		&Server::joinChannel,	1,	Server::REGISTRATION_REQUIRED,	2},
+	{"KICK",		&Server::kickChannel,	2,	Server::REGISTRATION_REQUIRED,	1},
+	{"MODE",		&Server::modeChannel,	1,	Server::REGISTRATION_REQUIRED,	1},
+	{"NAMES",		&Server::names,			0,	Server::REGISTRATION_REQUIRED,	1},
+	{"NICK",		&Server::nickName,		0,	Server::REGISTRATION_ANY,		2},
+	{"NOTICE",		&Server::notice,		1,	Server::REGISTRATION_REQUIRED,	1},
+	{"OPER",		&Server::oper,			2,	Server::REGISTRATION_REQUIRED,	2},
+	{"PASS",		&Server::password,		1,	Server::REGISTRATION_FORBIDDEN,	0},
+	{"PART",		&Server::partChannel,	1,	Server::REGISTRATION_REQUIRED,	1},
+	{"PING",		&Server::pong,			1,	Server::REGISTRATION_REQUIRED,	0},
+	{"PRIVMSG",		&Server::privmsg,		1,	Server::REGISTRATION_REQUIRED,	1},
+	{"QUIT",		&Server::userQuit,		0,	Server::REGISTRATION_ANY,		0},
+	{"STATS",		&Server::stats,			0,	Server::REGISTRATION_REQUIRED,	2},
+	{"TOPIC",		&Server::topicChannel,	1,	Server::REGISTRATION_REQUIRED,	1},
+	{"USER",		&Server::userName,		1,	Server::REGISTRATION_FORBIDDEN,	0},
+	{"USERHOST",	&Server::userHost,		1,	Server::REGISTRATION_REQUIRED,	1},
+	{"WHO",			&Server::who,			1,	Server::REGISTRATION_REQUIRED,	2},
+	{"WHOIS",		&Server::whoIs,			1,	Server::REGISTRATION_REQUIRED,	2},
+};
+
+# define COMMANDS_COUNT (sizeof(g_commands) / sizeof(*g_commands))
+
+/* Calls, allocations and durations of each entry of the table */
+static Server::CommandStats	g_commandStats[COMMANDS_COUNT];
+
+/* Handler durations of the commands already called, one series each */
+class CommandDuration : public Metric {
+
+public:
+	CommandDuration() : Metric("irc_command_duration_seconds", "Time spent in command handlers.") {}
+
+	virtual void	render(std::string &out) const
+	{
+		char	labels[32];
+
+		header(out, "summary");
+		for (size_t i = 0; i < COMMANDS_COUNT; ++i) {
+			if (!g_commandStats[i].latency.count())
+				continue ;
+			snprintf(labels, sizeof(labels), "command=\"%s\"", g_commands[i].name);
+			summary(out, labels, g_commandStats[i].latency);
+		}
+	}
+};
+
+static CommandDuration	g_commandDuration;
+
+/* Compares a command token to a table name, ignoring case */
+static bool	commandEquals(Span const &token, const char *name)
 {
-    const int	bufferSize = 1024;
-    char		buffer[bufferSize];
-    ssize_t		bytes;
-    std::string data;
-
-    memset(buffer, 0, bufferSize);
-    while (true) {
-        bytes = recv(sockfd, buffer, bufferSize - 1, 0);
-        if (bytes <= 0) {
-            break ;
-        }
-
-        data += std::string(buffer, bytes);
-        if (data[bytes - 1] != '\n') {
-            break ;
-        }
-    }
-    return (data);
+	size_t	i = 0;
+
+	for (; i < token.length && name[i]; ++i) {
+		if (toupper(static_cast<unsigned char>(token.data[i])) != name[i])
+			return (false);
+	}
+	return (i == token.length && !name[i]);
+}
+
+/* Looks for the command among the entries [first, last) of the table */
+static Server::Command const	*matchCommand(Span const &token, size_t first, size_t last)
+{
+	for (size_t i = first; i < last; ++i) {
+		if (commandEquals(token, g_commands[i].name))
+			return (&g_commands[i]);
+	}
+	return (NULL);
 }
 
 /*
-Parses commands received into a buffer by a user,
-processes them one by one,
-and updates the user's buffer accordingly.
-_commandBuffer and _command of the user are set by setBuffer at eatch iteration
-and each call fonction
+Entries [first, last) of the table for each first letter, built
+from the table at startup. A letter without command has an empty
+range, a group split in the table only costs a few more compares.
 */
-int	Server::getCommands(User &user, std::string & buffer) const
-{
-	size_t		pos = 0;
-
-	buffer = user.getBuffer() + buffer;
-	while (buffer.length()) {
-		pos = buffer.find('\n');
-		if (pos == std::string::npos) {
-			user.setBuffer(buffer);
-			return (1);
-		}
+class CommandIndex {
 
-		std::string	command = buffer.substr(0, pos);
-		user.addCommand(command);
-		buffer = buffer.substr(pos + 1, buffer.length());
-		user.setBuffer(buffer);
+public:
+	CommandIndex()
+	{
+		for (size_t i = 0; i < COMMANDS_COUNT; ++i) {
+			Range	&range = ranges[g_commands[i].name[0] - 'A'];
+
+			if (range.first == range.last)
+				range.first = i;
+			range.last = i + 1;
+		}
 	}
-	return (0);
+
+	struct Range {
+		Range() : first(0), last(0) {}
+
+		size_t	first;
+		size_t	last;
+	};
+
+	Range	ranges['Z' - 'A' + 1];
+};
+
+static CommandIndex const	g_commandIndex;
+
+/*
+Finds the entry of a command, whatever its case, among
+the entries of its first letter, with no allocation
+- Known command: returns its entry,
+- Unknown command: returns NULL.
+*/
+Server::Command const	*Server::findCommand(Span const &name)
+{
+	int const	letter = toupper(static_cast<unsigned char>(name.data[0]));
+
+	if (letter < 'A' || letter > 'Z')
+		return (NULL);
+	CommandIndex::Range const	&range = g_commandIndex.ranges[letter - 'A'];
+	return (matchCommand(name, range.first, range.last));
+}
+
+/* Entry of the table at index, NULL past its end */
+Server::Command const	*Server::getCommand(size_t index)
+{
+	return (index < COMMANDS_COUNT ? &g_commands[index] : NULL);
 }
 
-/*Parse the commands*/
-void	Server::parseCommands(
-	std::string &s,
-	std::string &cmd,
-	std::vector<std::string> &args,
-	std::string &mess
-) const {
-	size_t  pos;
+/* Nickname of a user in error replies, "*" before NICK */
+static std::string	replyNickname(User const &user)
+{
+	return (user.getNickname().empty() ? "*" : user.getNickname());
+}
 
-	pos = s.find('\r');
-    if (pos != std::string::npos) {
-        s = s.substr(0, pos);
+/*
+Executes one command line of a user: looks the command up in the
+table, answers the registration and parameter errors for every
+command, charges the flood penalty, then calls the handler.
+*/
+void	Server::execCommand(User &user, const char *line, size_t length)
+{
+	Message						message;
+	Command const				*command;
+	unsigned long const			allocations = threadAllocations();
+
+	if (!parseMessage(line, length, message))
+		return ;
+
+	g_commandsTotal.add();
+	command = findCommand(message.command);
+	if (!command)
+		g_unknownCommandsTotal.add();
+	if (!command && userIsConnected(user)) {
+		sendMessageToUser(user, Reply(ERR_UNKNOWNCOMMAND).arg(replyNickname(user)).arg(message.command).buffer());
+		return ;
+	} else if (!command || (command->registration == REGISTRATION_REQUIRED && !userIsConnected(user))) {
+		sendMessageToUser(user, Reply(ERR_NOTREGISTERED).arg(replyNickname(user)).buffer());
+		return ;
+	} else if (command->registration == REGISTRATION_FORBIDDEN && userIsConnected(user)) {
+		sendMessageToUser(user, Reply(ERR_ALREADYREGISTRED).arg(replyNickname(user)).buffer());
+		return ;
+	} else if (message.paramCount < command->minParams) {
+		sendMessageToUser(user, Reply(ERR_NEEDMOREPARAMS).arg(replyNickname(user)).arg(command->name).buffer());
+		return ;
 	}
 
-	pos = s.find(':');
-    if (pos != std::string::npos) {
-        mess = s.substr(++pos);
+	if (_config.floodLimit && command->cost) {
+		time_t	now = _reactor->now();
+		time_t	penalty = std::max(user.getFloodTime(), now) + command->cost;
+
+		user.setFloodTime(penalty);
+		if (static_cast<size_t>(penalty - now) > _config.floodLimit)
+			return (removeUser(user, "Excess Flood"));
 	}
 
-    std::stringstream ss(s.substr(0, --pos));
-    std::string token;
+	// the scratch strings keep their capacity from one command to the next
+	_args.resize(message.paramCount);
+	for (size_t i = 0; i < message.paramCount; ++i)
+		_args[i].assign(message.params[i].data, message.params[i].length);
+	if (message.hasTrailing)
+		_trailing.assign(message.trailing.data, message.trailing.length);
+	else
+		_trailing.clear();
+	unsigned long const	start = monotonicNanoseconds();
+	(this->*command->handler)(user, _args, _trailing);
+
+	CommandStats	&stats = g_commandStats[command - g_commands];
+	stats.latency.record(monotonicNanoseconds() - start);
+	++stats.calls;
+	stats.allocations += threadAllocations() - allocations;
+}
 
-    std::getline(ss, cmd, ' ');
-    while (std::getline(ss, token, ' ')) {
-        args.push_back(token);
-        token.clear();
-    }
+/* Prints the calls and heap allocations per command, for --alloc-stats */
+void	Server::printAllocationStats() const
+{
+	std::cerr << std::left << std::setw(12) << "COMMAND" << std::right << std::setw(12) << "calls"
+		<< std::setw(14) << "allocations" << std::setw(14) << "allocs/call" << std::endl;
+	for (size_t i = 0; i < COMMANDS_COUNT; ++i) {
+		if (!g_commandStats[i].calls)
+			continue ;
+		std::cerr << std::left << std::setw(12) << g_commands[i].name << std::right
+			<< std::setw(12) << g_commandStats[i].calls
+			<< std::setw(14) << g_commandStats[i].allocations
+			<< std::setw(14) << std::fixed << std::setprecision(2)
+			<< static_cast<double>(g_commandStats[i].allocations) / g_commandStats[i].calls << std::endl;
+	}
 }
 
 /*
-Processes pending commands for a user
-based on their type and content, performing
-appropriate actions for each command type.
+Ends an event-loop iteration:
+- every user who received messages during the iteration
+gets them in a single sendmsg call,
+- users whose queue outgrew --sendq are disconnected,
+- users removed during the iteration get a last
+chance to receive their queue, then are freed.
 */
-void	Server::execCommand(User &user)
+void	Server::flushPendingWrites()
 {
-	std::deque<std::string>		commands = user.getCommands();
+	for (size_t i = 0; i < _pendingFlush.size(); ++i) {
+		User	*user = _pendingFlush[i];
 
-	while (commands.size())
-	{
-		std::string 				cmd;
-		std::string 				mess;
-		std::vector<std::string>	args;
-		
-		parseCommands(commands.front(), cmd, args, mess);
-		commands.pop_front();
-
-		if (cmd.empty())
+		user->setFlushPending(false);
+		if (user->isClosing())
 			continue ;
+		if (_reactor->flush(*user))
+			removeUser(*user, "Connection closed");
+		else if (user->getSendQueue().size() > _config.sendqLimit)
+			removeUser(*user, "SendQ exceeded");
+	}
+	_pendingFlush.clear();
 
-		if (!userIsConnected(user)) {
-			if (cmd == "PASS" && !password(user, args))
-				return ;
-			else if (cmd == "USER")
-				userName(user, args);
-			else if (cmd == "NICK")
-				nickName(user, args);
-			else if (cmd == "QUIT")
-				return (removeUser(user, mess));
-		} else {
-			if (cmd == "NICK")
-				nickName(user, args);
-			else if (cmd == "PING")
-				pong(user, args);
-			else if (cmd == "NOTICE")
-				notice(user, args);
-			else if (cmd == "userhost")
-				userHost(user, args);
-			else if (cmd == "PRIVMSG")
-				privmsg(user, args, mess);
-			else if (cmd == "JOIN")
-				joinChannel(user, args);
-			else if (cmd == "PART")
-				partChannel(user, args, mess);
-			else if (cmd == "KICK")
-				kickChannel(user, args, mess);
-			else if (cmd == "INVITE")
-				inviteChannel(user, args);
-			else if (cmd == "TOPIC")
-				topicChannel(user, args, mess);
-			else if (cmd == "MODE")
-				modeChannel(user, args);
-			else if (cmd == "WHO")
-				who(user, args);
-			else if (cmd == "WHOIS")
-				whoIs(user, args);
-			else if (cmd == "QUIT")
-				return (removeUser(user, mess));
-		}
+	for (size_t i = 0; i < _closingUsers.size(); ++i) {
+		_reactor->removeConnection(*_closingUsers[i]);
+		delete _closingUsers[i];
 	}
-	user.setCommands(commands);
+	_closingUsers.clear();
 }
 
 void	Server::quit()
 {
-	for (std::vector<User *>::const_iterator it = _users.begin(); it != _users.end(); ++it) {
+	if (_config.allocStats)
+		printAllocationStats();
+
+	for (std::vector<User *>::const_iterator it = _connections.begin(); it != _connections.end(); ++it) {
+		if (!*it)
+			continue ;
+		_reactor->removeConnection(**it);
         delete *it;
     }
+	_connections.clear();
 
-	for (std::vector<Channel *>::const_iterator it = _channels.begin(); it != _channels.end(); ++it) {
-        delete *it;
+	for (std::tr1::unordered_map<std::string, Channel *>::const_iterator it = _channels.begin(); it != _channels.end(); ++it) {
+        delete it->second;
     }
+	_channels.clear();
 }
 
 /******************************************************************************/
@@ -325,74 +455,70 @@ int Server::checkPassword(std::string const & password) const {
 
 
 /*
-- creates a new user, 
-- creates a socket for it, 
-- adds it to an epoll event monitoring mechanism,
-- adds it to a list of connected users.
+Called by the reactor for each accepted socket:
+- creates a new user for it,
+- asks the reactor to watch its socket,
+- stores it in the connection table, at the index of its socket.
 */
-//after create new user in our struct it's time to add him into the event instance
-//whith epoll_ctl, we nedd a new struct epoll_event to associate with the sockfd user's
-//we set ev.events with EPOLLIN so the instance will watch for this socket the EPOLLIN event only
-//and we use EPOLL_CTL_ADD for adding the socket and the ev associate
-int	Server::createUser()
+int	Server::createUser(int sockfd, struct sockaddr_in const &addr)
 {
-	User				*user = new User();
-	struct epoll_event	ev;
-	int					sockfd;
+	User	*user = new User();
 
-	sockfd = user->createUserSocket(_socketServer);
-	if (!sockfd) {
-		delete user;
-		return (1);
-	}
-	
-	ev.events = EPOLLIN;
-	ev.data.fd = sockfd;
-	if (epoll_ctl(_epollfd, EPOLL_CTL_ADD, sockfd, &ev) == -1) {
+	user->setAddr(addr);
+	user->setSocket(sockfd);
+	user->setInet(inet_ntoa(addr.sin_addr));
+	if (_reactor->addConnection(*user)) {
+		close(sockfd);
 		delete user;
 		return (1);
 	}
 
-	_users.push_back(user);
+	if (static_cast<size_t>(sockfd) >= _connections.size())
+		_connections.resize(sockfd + 1, NULL);
+	_connections[sockfd] = user;
+	g_connectionsTotal.add();
+	g_users.add(1);
+	if (Capture::enabled())
+		Capture::open(sockfd, addr);
+	LOG_INFO << "connection from " << user->getInet() << " on socket " << sockfd;
 	return (0);
 }
 
 /*
 Removes a user from the server by :
-- removing its file descriptor from the epoll instance,
-- removing it from the _users user vector,
-- freeing the memory allocated for the user object.
+- removing it from the connection table,
+- scheduling the user object to be freed at the end
+of the event-loop iteration, once its queue is flushed
+and the reactor closed its socket.
 */
 void	Server::removeUser(User &user, std::string const & reason)
 {
-	struct epoll_event				ev;
-	std::vector<User *>::iterator	el;
-
-	if (epoll_ctl(_epollfd, EPOLL_CTL_DEL, user.getSocket(), &ev) == -1)
+	if (user.isClosing() || findUserBySocket(user.getSocket()) != &user)
 		return ;
+	_connections[user.getSocket()] = NULL;
+	if (Capture::enabled())
+		Capture::close(user.getSocket());
+	forgetNickname(user);
+	g_users.add(-1);
+	LOG_INFO << "closing socket " << user.getSocket() << " (" << user.getNickname() << "): " << reason;
 
-	el = std::find(_users.begin(), _users.end(), &user);
-	if (el == _users.end())
-		return ;
-	_users.erase(el);
-	
 	user.quit(*this, reason);
 
-	delete &user;
+	user.setClosing(true);
+	_closingUsers.push_back(&user);
 }
 
 /*
-Searches a list for a user based on the given socket file descriptor:
+Gets the user of a socket file descriptor from the connection table,
+in constant time since the reactors call it for every event:
 - success: returns the matching user if found,
 - Error: returns NULL.
 */
 User	*Server::findUserBySocket(const int sockfd) const
 {
-	for (std::vector<User *>::const_iterator it = _users.begin(); it != _users.end(); ++it) {
-        if ((*it)->getSocket() == sockfd)
-			return ((*it));
-    }
-	return (NULL);
+	if (sockfd < 0 || static_cast<size_t>(sockfd) >= _connections.size())
+		return (NULL);
+	return (_connections[sockfd]);
 }
 
 /*
@@ -402,25 +528,51 @@ Searches for a user in a list based on the given nickname:
 */
 User	*Server::findUserByNickname(const std::string &targetNickname, User const &user) const
 {
-	for (std::vector<User *>::const_iterator it = _users.begin(); it != _users.end(); ++it) {
-	    if ((*it)->getNickname() == targetNickname)
-			return ((*it));
-    }
-	throw Server::noSuchNick(user.getNickname(), targetNickname);
+	User	*target = findUserByNickname(targetNickname);
+
+	if (!target)
+		throw Server::noSuchNick(user.getNickname(), targetNickname);
+	return (target);
 }
 
 /*
-Searches for a user in a list based on the given nickname:
+Searches for a user in the nickname index, nicknames being
+compared with the RFC 1459 casemapping ("Bob" is "bob"):
 - success: returns the matching user if found,
 - Error: returns NULL.
 */
 User	*Server::findUserByNickname(const std::string &targetNickname) const
 {
-	for (std::vector<User *>::const_iterator it = _users.begin(); it != _users.end(); ++it) {
-	    if ((*it)->getNickname() == targetNickname)
-			return ((*it));
-    }
-	return (NULL);
+	std::tr1::unordered_map<std::string, User *>::const_iterator	it;
+
+	it = _nicknames.find(ircLower(targetNickname));
+	if (it == _nicknames.end())
+		return (NULL);
+	return (it->second);
+}
+
+/* Renames a user, keeping the nickname index and the names replies of its channels up to date */
+void	Server::setNickname(User &user, std::string const &nickname)
+{
+	std::vector<Membership *> const	&memberships = user.getMemberships();
+
+	for (size_t i = 0; i < memberships.size(); i++)
+		memberships[i]->channel->invalidateNames();
+	forgetNickname(user);
+	_nicknames[ircLower(nickname)] = &user;
+	user.setNickname(nickname);
+}
+
+/* Removes the nickname of a user from the index */
+void	Server::forgetNickname(User &user)
+{
+	std::tr1::unordered_map<std::string, User *>::iterator	it;
+
+	if (user.getNickname().empty())
+		return ;
+	it = _nicknames.find(ircLower(user.getNickname()));
+	if (it != _nicknames.end() && it->second == &user)
+		_nicknames.erase(it);
 }
 
 /******************************************************************************/
@@ -428,7 +580,7 @@ User	*Server::findUserByNickname(const std::string &targetNickname) const
 /******************************************************************************/
 
 /*
-Creates and adds a new channel to a list of channels.
+Creates and adds a new channel to the channel directory.
 Returns this newly created channel.
 */
 Channel	*Server::createChannel(User &user, std::string const & channelName)//pas forcement besoin de *user 
@@ -445,22 +597,27 @@ Channel	*Server::createChannel(User &user, std::string const & channelName)//pas
 	creationTime << timestamp;
 	channel = new Channel(channelName, creatorInfos, creationTime.str());//a proteger avec une exception?
 
-	_channels.push_back(channel);
+	_channels[ircLower(channelName)] = channel;
+	g_channels.add(1);
 	return (channel);
 }
 
 /*
-Searches for a channel in a list based on the given name:
+Searches for a channel in the channel directory, names being
+compared with the RFC 1459 casemapping:
 - success: returns the matching channel if found,
-- Error: throw an exception.
+- Error: returns NULL.
 */
-Channel	*Server::findChannelByName(std::string const & name, User const &user) const
+Channel	*Server::findChannel(std::string const & name) const
 {
-	for (std::vector<Channel *>::const_iterator it = _channels.begin(); it != _channels.end(); ++it) {
-		if ((*it)->getName() == name)
-			return ((*it));
-	}
-	throw Server::noSuchChannel(user.getNickname(), name);
+	std::tr1::unordered_map<std::string, Channel *>::const_iterator	it;
+
+	if (!isChannelName(name))
+		return (NULL);
+	it = _channels.find(ircLower(name));
+	if (it == _channels.end())
+		return (NULL);
+	return (it->second);
 }
 
 /*
@@ -468,12 +625,14 @@ Remove and delete the channel given as parameter.
 */
 void	Server::removeChannel(Channel *channel)
 {
-	std::vector<Channel *>::iterator el;
-	el = std::find(_channels.begin(), _channels.end(), channel);
-	if (el == _channels.end())
+	std::tr1::unordered_map<std::string, Channel *>::iterator	it;
+
+	it = _channels.find(ircLower(channel->getName()));
+	if (it == _channels.end() || it->second != channel)
 		return ;
 	
-	_channels.erase(el);
+	_channels.erase(it);
+	g_channels.add(-1);
 	delete channel;
 }
 
@@ -482,57 +641,125 @@ void	Server::removeChannel(Channel *channel)
 /******************************************************************************/
 
 /*
-Sends a message to a user on its socket
+Queues a message for a user, the queue is written once
+at the end of the event-loop iteration by flushPendingWrites
 - Success: returns 0
 - Error: returns 1.
 */
-int	Server::sendMessageToUser(const User &user, const std::string message) const
+int	Server::sendMessageToUser(const User &user, std::string const &message) const
 {
-	std::cout << "sending to " + user.getNickname() + "... "  << message;
-	int sendBytes = send(user.getSocket(), message.c_str(), message.length(), 0);
-	if (sendBytes == -1)
-		return (1);
-	return (0);
+	return (sendMessageToUser(user, SharedBuffer(message)));
 }
 
 /*
-Sends a message to every member of a channel on their socket
+Queues a reference to an already serialized message for a user,
+the same buffer can be queued for any number of users
 - Success: returns 0
 - Error: returns 1.
 */
-void	Server::sendMessageToALL(const User &user, std::map<User *, bool> users, std::string message, bool toMe) const
+int	Server::sendMessageToUser(const User &user, SharedBuffer const &message) const
 {
-	for (std::map<User *, bool>::iterator it = users.begin(); it != users.end(); it++) {
-		if (!toMe && &user == it->first)
+	User	&target = const_cast<User &>(user);
+
+	// over --sendq, the user is disconnected at the end of the iteration
+	if (target.isClosing() || target.getSendQueue().size() > _config.sendqLimit) {
+		g_sendFailuresTotal.add();
+		return (1);
+	}
+
+	g_messagesQueuedTotal.add();
+	LOG_DEBUG << "sending to " << user.getNickname() << ": " << std::string(message.data(), message.length());
+	target.queueMessage(message);
+	if (!target.isFlushPending()) {
+		target.setFlushPending(true);
+		_pendingFlush.push_back(&target);
+	}
+	return (0);
+}
+
+/*
+Sends a message to every member of a channel on their socket,
+the message is serialized once and shared by every recipient.
+*/
+void	Server::sendMessageToALL(const User &user, MemberList const &users, std::string const &message, bool toMe) const
+{
+	sendMessageToALL(user, users, SharedBuffer(message), toMe);
+}
+
+void	Server::sendMessageToALL(const User &user, MemberList const &users, SharedBuffer const &buffer, bool toMe) const
+{
+	unsigned long	recipients = 0;
+
+	for (size_t i = 0; i < users.size(); i++) {
+		if (!toMe && &user == users[i].user)
 			continue ;
-		sendMessageToUser(*(*it).first, message);
+		sendMessageToUser(*users[i].user, buffer);
+		++recipients;
 	}
+	g_fanoutRecipients.observe(recipients);
+}
+
+/*
+Sends a message once to every user sharing at least one channel with
+the given user, and to the user itself if toMe is set. A user shared
+through several channels is marked with the epoch of this fan-out the
+first time it is met, so it gets the message only once.
+*/
+void	Server::sendMessageToNeighbours(User &user, std::string const &message, bool toMe)
+{
+	SharedBuffer						buffer(message);
+	std::vector<Membership *> const		&memberships = user.getMemberships();
+	unsigned long const					epoch = ++_fanoutEpoch;
+	unsigned long						recipients = 0;
+
+	user.setFanoutMark(epoch);
+	if (toMe) {
+		sendMessageToUser(user, buffer);
+		++recipients;
+	}
+
+	for (size_t i = 0; i < memberships.size(); i++) {
+		MemberList const	&members = memberships[i]->channel->getMembers();
+
+		for (size_t j = 0; j < members.size(); j++) {
+			User	&neighbour = *members[j].user;
+
+			if (neighbour.getFanoutMark() == epoch)
+				continue ;
+			neighbour.setFanoutMark(epoch);
+			sendMessageToUser(neighbour, buffer);
+			++recipients;
+		}
+	}
+	g_fanoutRecipients.observe(recipients);
 }
 
 /*
 Sends a message to a user specified by nickname
 or to all members of a channel specified by name,
-depending on the given target.
+depending on the given target. A sender who is not
+on the channel gets ERR_CANNOTSENDTOCHAN.
 */
-void	Server::sendMessage(const User &user, std::string target, std::string message) const
+void	Server::sendMessage(const User &user, std::string const &target, SharedBuffer const &message) const
 {
-	Channel				*channel;
-	User				*usertarget;
-	
-	try {
-		channel = findChannelByName(target, user);
+	Channel				*channel = NULL;
+	User				*usertarget = NULL;
+	std::string			mess;
+
+	if (isChannelName(target))
+		channel = findChannel(target);
+	else
+		usertarget = findUserByNickname(target);
+
+	if (channel) {
 		if (channel->userOnChannel(const_cast<User &>(user)))
 			sendMessageToALL(user, channel->getMembers(), message, false);
-	
-	} catch (const std::exception& e) {
-		try {
-			usertarget = findUserByNickname(target, user);
-		
-		} catch(const std::exception& e) {
-			sendMessageToUser(user, e.what());
-			return ;
-		}
-
+		else
+			sendMessageToUser(user, Reply(ERR_CANNOTSENDTOCHAN).arg(user.getNickname()).arg(target).buffer());
+	} else if (usertarget) {
 		sendMessageToUser(*usertarget, message);
+	} else {
+		mess = ERR_NOSUCHNICK(user.getNickname(), target);
+		sendMessageToUser(user, mess);
 	}
 }
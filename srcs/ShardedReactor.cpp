@@ -0,0 +1,563 @@
+#include "ShardedReactor.hpp"
+#include "Server.hpp"
+
+#include <sys/eventfd.h>
+
+/******************************************************************************/
+/*						CONSTRUCTORS & DESTRUCTORS							  */
+/******************************************************************************/
+
+ShardedReactor::Message::Message() :
+	next(NULL),
+	type(DATA),
+	fd(-1),
+	shard(NULL)
+{
+	memset(&addr, 0, sizeof(addr));
+}
+
+ShardedReactor::Connection::Connection() :
+	writeArmed(false),
+	closed(false)
+{}
+
+ShardedReactor::Shard::Shard() :
+	reactor(NULL),
+	running(false),
+	stop(false),
+	dirty(false),
+	socketServer(-1),
+	epollfd(-1),
+	wakefd(-1)
+{}
+
+ShardedReactor::ShardedReactor(Server &server, Config const &config) :
+	_server(server),
+	_edgeTriggered(config.edgeTriggered),
+	_count(config.reactors),
+	_backlog(config.backlog),
+	_acceptBudget(config.acceptBudget),
+	_sendqLimit(config.sendqLimit),
+	_epollfd(-1),
+	_wakefd(-1)
+{}
+
+/*
+Destructor, stopping every shard thread before closing
+what they owned and freeing the messages still queued.
+*/
+ShardedReactor::~ShardedReactor()
+{
+	Message	*message;
+
+	for (size_t i = 0; i < _shards.size(); ++i) {
+		stopShard(*_shards[i]);
+		delete _shards[i];
+	}
+	_shards.clear();
+
+	while ((message = _inbox.pop()))
+		delete message;
+	release(_spare);
+	if (_wakefd != -1)
+		close(_wakefd);
+	if (_epollfd != -1)
+		close(_epollfd);
+}
+
+/*
+Joins a shard thread, then executes what the server posted after its
+last tick, so that the last replies are written, and closes the sockets.
+*/
+void	ShardedReactor::stopShard(Shard &shard)
+{
+	uint64_t	one = 1;
+
+	if (shard.running) {
+		__atomic_store_n(&shard.stop, true, __ATOMIC_RELEASE);
+		if (write(shard.wakefd, &one, sizeof(one)) == -1)
+			LOG_ERROR << "cannot wake shard";
+		pthread_join(shard.thread, NULL);
+	}
+	handleInbox(shard);
+	release(shard.spare);
+
+	for (size_t fd = 0; fd < shard.connections.size(); ++fd) {
+		if (shard.connections[fd]) {
+			close(fd);
+			delete shard.connections[fd];
+		}
+	}
+	if (shard.epollfd != -1)
+		close(shard.epollfd);
+	if (shard.wakefd != -1)
+		close(shard.wakefd);
+	if (shard.socketServer != -1 && shard.reactor->_shards[0] != &shard)
+		close(shard.socketServer);
+}
+
+/*
+Takes a message from the spare ones of the calling thread,
+allocating one only when none came back yet. The data string keeps
+its capacity, so a reused message reads without allocating.
+*/
+ShardedReactor::Message	*ShardedReactor::acquire(MpscQueue<Message> &spare)
+{
+	Message	*message = spare.pop();
+
+	if (!message)
+		return (new Message());
+	message->fd = -1;
+	message->shard = NULL;
+	message->data.clear();
+	message->queue.clear();
+	return (message);
+}
+
+/* Frees the spare messages, once no other thread gives any back */
+void	ShardedReactor::release(MpscQueue<Message> &spare)
+{
+	Message	*message;
+
+	while ((message = spare.pop()))
+		delete message;
+}
+
+/******************************************************************************/
+/*							SERVER THREAD SIDE								  */
+/******************************************************************************/
+
+/*
+Creates the shards: the first one uses the server socket,
+the others open their own SO_REUSEPORT socket on the same port
+so that the kernel spreads new connections among them.
+Shard threads don't take SIGINT, the server thread handles it.
+*/
+void	ShardedReactor::start(int socketServer)
+{
+	struct epoll_event	ev;
+	sigset_t			blocked;
+	sigset_t			previous;
+
+	_wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	_epollfd = epoll_create1(0);
+	if (_wakefd == -1 || _epollfd == -1)
+		throw std::runtime_error("Error: failed to create epoll");
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = _wakefd;
+	if (epoll_ctl(_epollfd, EPOLL_CTL_ADD, _wakefd, &ev) == -1)
+		throw std::runtime_error("Error: failed to manage sockets");
+
+	sigemptyset(&blocked);
+	sigaddset(&blocked, SIGINT);
+	for (size_t i = 0; i < _count; ++i) {
+		Shard	*shard = new Shard();
+
+		_shards.push_back(shard);
+		shard->reactor = this;
+		shard->socketServer = (i == 0) ? socketServer : _server.openSocket(true);
+		if (i != 0 && listen(shard->socketServer, _backlog) < 0)
+			throw std::runtime_error("Error: failed to listen on socket");
+
+		shard->epollfd = epoll_create1(0);
+		shard->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (shard->epollfd == -1 || shard->wakefd == -1)
+			throw std::runtime_error("Error: failed to create epoll");
+
+		ev.data.fd = shard->socketServer;
+		if (epoll_ctl(shard->epollfd, EPOLL_CTL_ADD, shard->socketServer, &ev) == -1)
+			throw std::runtime_error("Error: failed to manage sockets");
+		ev.data.fd = shard->wakefd;
+		if (epoll_ctl(shard->epollfd, EPOLL_CTL_ADD, shard->wakefd, &ev) == -1)
+			throw std::runtime_error("Error: failed to manage sockets");
+
+		pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+		shard->running = (pthread_create(&shard->thread, NULL, &ShardedReactor::shardMain, shard) == 0);
+		pthread_sigmask(SIG_SETMASK, &previous, NULL);
+		if (!shard->running)
+			throw std::runtime_error("Error: failed to start reactor thread");
+	}
+}
+
+/*
+Wakes the shards which received work during the previous batch,
+waits for the shards to post something, then dispatches it all.
+An interrupted wait is not an error, the caller checks g_end.
+*/
+int	ShardedReactor::poll()
+{
+	struct epoll_event	ev;
+	uint64_t			value = 1;
+	Message				*message;
+
+	for (size_t i = 0; i < _shards.size(); ++i) {
+		if (_shards[i]->dirty) {
+			_shards[i]->dirty = false;
+			if (write(_shards[i]->wakefd, &value, sizeof(value)) == -1)
+				return (-1);
+		}
+	}
+
+	if (epoll_wait(_epollfd, &ev, 1, -1) == -1)
+		return ((errno == EINTR) ? 0 : -1);
+	woke();
+	if (read(_wakefd, &value, sizeof(value)) == -1 && errno != EAGAIN)
+		return (-1);
+
+	while ((message = _inbox.pop())) {
+		dispatch(*message);
+		message->shard->spare.push(message);
+	}
+	return (0);
+}
+
+/* Applies what a shard posted to the users of the server */
+void	ShardedReactor::dispatch(Message &message)
+{
+	User	*user;
+
+	if (message.type == Message::ACCEPT) {
+		if ((size_t)message.fd >= _owners.size())
+			_owners.resize(message.fd + 1, NULL);
+		_owners[message.fd] = message.shard;
+		_server.createUser(message.fd, message.addr);
+		return ;
+	}
+
+	user = _server.findUserBySocket(message.fd);
+	if (!user || user->isClosing())
+		return ;
+
+	if (message.type == Message::DATA) {
+		user->appendBuffer(message.data.c_str(), message.data.length());
+		_server.handleInput(*user, false);
+	} else if (message.type == Message::CLOSED) {
+		_server.removeUser(*user, "Connection closed");
+	} else if (message.type == Message::SENDQ) {
+		_server.removeUser(*user, "SendQ exceeded");
+	}
+}
+
+/* The shard registered the socket when accepting it */
+int	ShardedReactor::addConnection(User &user)
+{
+	(void)user;
+	return (0);
+}
+
+/*
+Hands what is left in the user's queue to its shard,
+then asks the shard to close the socket.
+*/
+void	ShardedReactor::removeConnection(User &user)
+{
+	Message	*message;
+
+	flush(user);
+	message = acquire(_spare);
+	message->type = Message::CLOSE;
+	message->fd = user.getSocket();
+	send(*_owners[message->fd], message);
+}
+
+/*
+Moves the outbound queue of a user to the shard owning its socket,
+the messages themselves are not copied
+- Success: returns 0
+- Error: returns 1.
+*/
+int	ShardedReactor::flush(User &user)
+{
+	Message	*message;
+
+	if (!user.hasPendingOutput())
+		return (0);
+
+	message = acquire(_spare);
+	message->type = Message::SEND;
+	message->fd = user.getSocket();
+	user.releaseSendQueue(message->queue);
+	send(*_owners[message->fd], message);
+	return (0);
+}
+
+/* Queues a message for a shard, woken at the beginning of the next poll */
+void	ShardedReactor::send(Shard &shard, Message *message)
+{
+	shard.inbox.push(message);
+	shard.dirty = true;
+}
+
+/******************************************************************************/
+/*								SHARD THREAD SIDE							  */
+/******************************************************************************/
+
+void	*ShardedReactor::shardMain(void *arg)
+{
+	Shard	*shard = static_cast<Shard *>(arg);
+
+	shard->reactor->runShard(*shard);
+	return (NULL);
+}
+
+/*
+Event loop of a shard: accepts on its own listening socket,
+reads and writes its sockets, then executes what the server
+thread asked for. The server thread is woken once per batch.
+*/
+void	ShardedReactor::runShard(Shard &shard)
+{
+	struct epoll_event	events[EVENTS_MAX];
+	uint64_t			value;
+	int					nfds;
+	bool				posted;
+
+	while (!__atomic_load_n(&shard.stop, __ATOMIC_ACQUIRE)) {
+		nfds = epoll_wait(shard.epollfd, events, EVENTS_MAX, -1);
+		if (nfds == -1 && errno == EINTR)
+			continue ;
+		if (nfds == -1)
+			break ;
+
+		posted = false;
+		for (int n = 0; n < nfds; ++n) {
+			int	fd = events[n].data.fd;
+
+			if (fd == shard.wakefd) {
+				if (read(shard.wakefd, &value, sizeof(value)) == -1 && errno != EAGAIN)
+					return ;
+			} else if (fd == shard.socketServer) {
+				posted |= acceptConnection(shard);
+			} else {
+				posted |= handleEvents(shard, fd, events[n].events);
+			}
+		}
+		posted |= handleInbox(shard);
+
+		value = 1;
+		if (posted && write(_wakefd, &value, sizeof(value)) == -1)
+			return ;
+	}
+}
+
+/* Posts a message to the server thread */
+void	ShardedReactor::post(Shard &shard, Message *message)
+{
+	message->shard = &shard;
+	_inbox.push(message);
+}
+
+/*
+Accepts the pending connections on the shard socket until EAGAIN or
+until the accept budget of the tick is spent, and tells the server
+about each of them. The listening socket is level-triggered.
+Out of file descriptors, the pending connections are refused.
+*/
+bool	ShardedReactor::acceptConnection(Shard &shard)
+{
+	struct epoll_event	ev;
+	Message				*message;
+	int					socket;
+	socklen_t			size;
+	bool				posted = false;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = _edgeTriggered ? EPOLLIN | EPOLLET : EPOLLIN;
+	for (size_t count = 0; count < _acceptBudget; ++count) {
+		message = acquire(shard.spare);
+		size = sizeof(message->addr);
+		socket = accept4(shard.socketServer, (struct sockaddr *)&message->addr, &size, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (socket == -1) {
+			shard.spare.push(message);
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue ;
+			if ((errno == EMFILE || errno == ENFILE) && shard.reserve.shed(shard.socketServer))
+				continue ;
+			break ;
+		}
+
+		ev.data.fd = socket;
+		if (epoll_ctl(shard.epollfd, EPOLL_CTL_ADD, socket, &ev) == -1) {
+			close(socket);
+			shard.spare.push(message);
+			continue ;
+		}
+
+		if ((size_t)socket >= shard.connections.size())
+			shard.connections.resize(socket + 1, NULL);
+		shard.connections[socket] = new Connection();
+
+		message->type = Message::ACCEPT;
+		message->fd = socket;
+		post(shard, message);
+		posted = true;
+	}
+	return (posted);
+}
+
+/*
+Handles events on a client socket of the shard: flushes it when
+writable, posts what it reads to the server thread and reports
+the connection as closed on end of file or error.
+The socket stays open until the server sends CLOSE.
+*/
+bool	ShardedReactor::handleEvents(Shard &shard, int fd, uint32_t events)
+{
+	Connection	*conn = shard.connections[fd];
+	Message		*message;
+	bool		posted = false;
+	bool		closed = false;
+
+	if (!conn || conn->closed)
+		return (false);
+
+	if ((events & EPOLLERR) || ((events & EPOLLOUT) && flushConnection(shard, fd) == -1))
+		closed = true;
+
+	if (!closed && (events & EPOLLIN)) {
+		message = acquire(shard.spare);
+		message->type = Message::DATA;
+		message->fd = fd;
+		closed = (receiveData(shard, fd, message->data) == -1);
+		if (message->data.empty()) {
+			shard.spare.push(message);
+		} else {
+			post(shard, message);
+			posted = true;
+		}
+	} else if (events & EPOLLHUP) {
+		closed = true;
+	}
+
+	if (closed) {
+		struct epoll_event	ev;
+
+		conn->closed = true;
+		conn->queue.clear();
+		epoll_ctl(shard.epollfd, EPOLL_CTL_DEL, fd, &ev);
+		message = acquire(shard.spare);
+		message->type = Message::CLOSED;
+		message->fd = fd;
+		post(shard, message);
+		posted = true;
+	}
+	return (posted);
+}
+
+/*
+Receives data from a socket of the shard, straight into the message.
+In edge-triggered mode the socket is drained until EAGAIN,
+otherwise a single read is done.
+A drain stops after RECV_BUDGET bytes, re-arming the socket
+so that it is reported again at the next tick.
+- Success: returns 0,
+- Connection closed or broken: returns -1.
+*/
+int	ShardedReactor::receiveData(Shard &shard, int fd, std::string &data)
+{
+	struct epoll_event	ev;
+	size_t				length;
+	ssize_t				bytes;
+
+	while (true) {
+		if (data.length() >= RECV_BUDGET) {
+			memset(&ev, 0, sizeof(ev));
+			ev.events = _edgeTriggered ? EPOLLIN | EPOLLET : EPOLLIN;
+			if (shard.connections[fd]->writeArmed)
+				ev.events |= EPOLLOUT;
+			ev.data.fd = fd;
+			return ((epoll_ctl(shard.epollfd, EPOLL_CTL_MOD, fd, &ev) == -1) ? -1 : 0);
+		}
+
+		length = data.length();
+		data.resize(length + BUFFER_SIZE);
+		bytes = recv(fd, &data[length], BUFFER_SIZE, 0);
+		data.resize(length + std::max(bytes, (ssize_t)0));
+		if (bytes > 0) {
+			if (!_edgeTriggered)
+				return (0);
+			continue ;
+		}
+
+		if (bytes == -1 && errno == EINTR)
+			continue ;
+		if (bytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return (0);
+		return (-1);
+	}
+}
+
+/*
+Writes the queue of a socket of the shard and keeps EPOLLOUT
+armed only while some bytes are still waiting
+- Success: returns 0
+- Error: returns -1.
+*/
+int	ShardedReactor::flushConnection(Shard &shard, int fd)
+{
+	Connection			*conn = shard.connections[fd];
+	struct epoll_event	ev;
+	int					status;
+
+	status = conn->queue.send(fd);
+	if (status == -1)
+		return (-1);
+
+	if ((status == 1) != conn->writeArmed) {
+		memset(&ev, 0, sizeof(ev));
+		ev.events = _edgeTriggered ? EPOLLIN | EPOLLET : EPOLLIN;
+		if (status == 1)
+			ev.events |= EPOLLOUT;
+		ev.data.fd = fd;
+		if (epoll_ctl(shard.epollfd, EPOLL_CTL_MOD, fd, &ev) == -1)
+			return (-1);
+		conn->writeArmed = (status == 1);
+	}
+	return (0);
+}
+
+/*
+Executes what the server thread asked for:
+- SEND appends the messages to the socket queue and flushes it,
+the connection is reported closed when the queue outgrew --sendq,
+- CLOSE gives the socket a last chance to flush, then closes it.
+Returns whether a message was posted to the server thread,
+which must then be woken.
+*/
+bool	ShardedReactor::handleInbox(Shard &shard)
+{
+	Message	*message;
+	bool	posted = false;
+
+	while ((message = shard.inbox.pop())) {
+		int			fd = message->fd;
+		Connection	*conn = ((size_t)fd < shard.connections.size()) ? shard.connections[fd] : NULL;
+
+		if (conn && message->type == Message::SEND && !conn->closed) {
+			conn->queue.append(message->queue);
+			int	status = flushConnection(shard, fd);
+			if (status == -1 || conn->queue.size() > _sendqLimit) {
+				struct epoll_event	ev;
+				Message				*closed = acquire(shard.spare);
+
+				conn->closed = true;
+				conn->queue.clear();
+				epoll_ctl(shard.epollfd, EPOLL_CTL_DEL, fd, &ev);
+				closed->type = (status == -1) ? Message::CLOSED : Message::SENDQ;
+				closed->fd = fd;
+				post(shard, closed);
+				posted = true;
+			}
+		} else if (conn && message->type == Message::CLOSE) {
+			if (!conn->closed)
+				conn->queue.send(fd);
+			close(fd);
+			delete conn;
+			shard.connections[fd] = NULL;
+		}
+		_spare.push(message);
+	}
+	return (posted);
+}
@@ -0,0 +1,152 @@
+#include "SharedBuffer.hpp"
+
+#include <vector>
+#include <string.h>
+
+/******************************************************************************/
+/*									SLABS									  */
+/******************************************************************************/
+
+/*
+Fixed-size blocks carved from slabs of BUFFER_SLAB_BLOCKS, recycled
+through a free list. Slabs are only given back when the program ends.
+The lock is a spinlock since it is held for a few instructions.
+*/
+namespace {
+
+	struct SlabPool {
+		SlabPool() : freeList(NULL), lock(0) {}
+		~SlabPool()
+		{
+			for (size_t i = 0; i < slabs.size(); ++i)
+				delete[] slabs[i];
+		}
+
+		void	acquire() { while (__sync_lock_test_and_set(&lock, 1)) ; }
+		void	unlock() { __sync_lock_release(&lock); }
+
+		void				*freeList;
+		int					lock;
+		std::vector<char *>	slabs;
+	};
+
+	SlabPool	g_pool;
+
+}
+
+/******************************************************************************/
+/*						CONSTRUCTORS & DESTRUCTORS							  */
+/******************************************************************************/
+
+SharedBuffer::SharedBuffer() : _block(NULL) {}
+
+/* Serializes the message once, its bytes are never modified afterwards */
+SharedBuffer::SharedBuffer(std::string const &content) : _block(NULL)
+{
+	if (content.empty())
+		return ;
+
+	_block = allocate(content.length());
+	memcpy(_block + 1, content.data(), content.length());
+}
+
+/* Takes the reference of a block filled in place by a Reply */
+SharedBuffer::SharedBuffer(Block *block) : _block(block) {}
+
+SharedBuffer::SharedBuffer(SharedBuffer const &src) : _block(src._block)
+{
+	if (_block)
+		__atomic_add_fetch(&_block->refs, 1, __ATOMIC_RELAXED);
+}
+
+SharedBuffer::~SharedBuffer()
+{
+	if (_block)
+		release(_block);
+}
+
+/******************************************************************************/
+/*							OPERATOR OVERLOADS								  */
+/******************************************************************************/
+
+SharedBuffer	&SharedBuffer::operator=(SharedBuffer const &src)
+{
+	if (src._block)
+		__atomic_add_fetch(&src._block->refs, 1, __ATOMIC_RELAXED);
+	if (_block)
+		release(_block);
+	_block = src._block;
+	return (*this);
+}
+
+/******************************************************************************/
+/*								ALLOCATION									  */
+/******************************************************************************/
+
+/*
+Takes a block from the free list, cutting a new slab when it is empty,
+or allocates a dedicated block for messages too long for a slab.
+*/
+SharedBuffer::Block	*SharedBuffer::allocate(size_t length)
+{
+	Block	*block;
+
+	if (length > BUFFER_SLAB_PAYLOAD) {
+		block = reinterpret_cast<Block *>(new char[sizeof(Block) + length]);
+		block->slab = false;
+	} else {
+		g_pool.acquire();
+		if (!g_pool.freeList) {
+			// header and payload, aligned on a pointer
+			size_t	size = (sizeof(Block) + BUFFER_SLAB_PAYLOAD + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+			char	*slab = NULL;
+
+			try {
+				slab = new char[size * BUFFER_SLAB_BLOCKS];
+				g_pool.slabs.push_back(slab);
+			} catch (...) {
+				delete[] slab;
+				g_pool.unlock();
+				throw ;
+			}
+			for (size_t i = 0; i < BUFFER_SLAB_BLOCKS; ++i) {
+				block = reinterpret_cast<Block *>(slab + i * size);
+				block->next = static_cast<Block *>(g_pool.freeList);
+				g_pool.freeList = block;
+			}
+		}
+		block = static_cast<Block *>(g_pool.freeList);
+		g_pool.freeList = block->next;
+		g_pool.unlock();
+		block->slab = true;
+	}
+
+	block->next = NULL;
+	block->refs = 1;
+	block->length = length;
+	return (block);
+}
+
+/* Drops a reference, the last one gives the block back */
+void	SharedBuffer::release(Block *block)
+{
+	if (__atomic_sub_fetch(&block->refs, 1, __ATOMIC_ACQ_REL) != 0)
+		return ;
+
+	if (!block->slab) {
+		delete[] reinterpret_cast<char *>(block);
+		return ;
+	}
+	g_pool.acquire();
+	block->next = static_cast<Block *>(g_pool.freeList);
+	g_pool.freeList = block;
+	g_pool.unlock();
+}
+
+/******************************************************************************/
+/*								GETTERS										  */
+/******************************************************************************/
+
+const char	*SharedBuffer::data() const { return (_block ? reinterpret_cast<const char *>(_block + 1) : ""); }
+size_t		SharedBuffer::length() const { return (_block ? _block->length : 0); }
+bool		SharedBuffer::empty() const { return (!_block); }
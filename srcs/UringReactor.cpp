@@ -0,0 +1,563 @@
+#include "UringReactor.hpp"
+#include "Server.hpp"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/******************************************************************************/
+/*						CONSTRUCTORS & DESTRUCTORS							  */
+/******************************************************************************/
+
+UringReactor::Connection::Connection() :
+	user(NULL),
+	recvArmed(false),
+	sendFailed(false),
+	sendInflight(false)
+{
+	memset(&msg, 0, sizeof(msg));
+}
+
+/*
+Sets up the ring and maps its submission and completion queues.
+Throws when the kernel lacks io_uring or the features we rely on,
+so that Reactor::create can fall back to epoll.
+*/
+UringReactor::UringReactor(Server &server, Config const &config) :
+	_server(server),
+	_ringfd(-1),
+	_socketServer(-1),
+	_toSubmit(0),
+	_multishotAccept(true),
+	_multishotRecv(true),
+	_cancelByFd(true),
+	_acceptPaused(false),
+	_sqRing(MAP_FAILED),
+	_sqRingSize(0),
+	_cqRing(MAP_FAILED),
+	_cqRingSize(0),
+	_sqes((struct io_uring_sqe *)MAP_FAILED),
+	_sqesSize(0),
+	_buffers(NULL)
+{
+	struct io_uring_params	params;
+	char					*sq;
+	char					*cq;
+
+	(void)config;
+	memset(&params, 0, sizeof(params));
+	params.flags = IORING_SETUP_CQSIZE;
+	params.cq_entries = URING_ENTRIES * 4;
+	_ringfd = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+	if (_ringfd == -1)
+		throw std::runtime_error("Error: io_uring unavailable");
+
+	if (!(params.features & IORING_FEAT_NODROP) || !supportsOperations()) {
+		close(_ringfd);
+		throw std::runtime_error("Error: io_uring too old");
+	}
+
+	_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+		_sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+
+	_sqRing = mmap(NULL, _sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringfd, IORING_OFF_SQ_RING);
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+		_cqRing = _sqRing;
+	else
+		_cqRing = mmap(NULL, _cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringfd, IORING_OFF_CQ_RING);
+	_sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+	_sqes = (struct io_uring_sqe *)mmap(NULL, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringfd, IORING_OFF_SQES);
+	if (_sqRing == MAP_FAILED || _cqRing == MAP_FAILED || _sqes == MAP_FAILED) {
+		release();
+		throw std::runtime_error("Error: cannot map io_uring");
+	}
+
+	sq = (char *)_sqRing;
+	_sqHead = (unsigned *)(sq + params.sq_off.head);
+	_sqTail = (unsigned *)(sq + params.sq_off.tail);
+	_sqMask = *(unsigned *)(sq + params.sq_off.ring_mask);
+	_sqEntries = *(unsigned *)(sq + params.sq_off.ring_entries);
+	_sqArray = (unsigned *)(sq + params.sq_off.array);
+
+	cq = (char *)_cqRing;
+	_cqHead = (unsigned *)(cq + params.cq_off.head);
+	_cqTail = (unsigned *)(cq + params.cq_off.tail);
+	_cqMask = *(unsigned *)(cq + params.cq_off.ring_mask);
+	_cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+	_buffers = new char[URING_BUFFERS * BUFFER_SIZE];
+}
+
+/* Destructor, submitting the last sends before the ring is closed */
+UringReactor::~UringReactor()
+{
+	if (_toSubmit)
+		submit(0);
+	release();
+}
+
+/*
+Probes the opcodes the backend submits. The multishot flags and
+cancelling by socket have no opcode nor feature bit of their own,
+the completions tell when they are rejected.
+*/
+bool	UringReactor::supportsOperations() const
+{
+	static const unsigned char	required[] = {
+		IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SENDMSG,
+		IORING_OP_PROVIDE_BUFFERS, IORING_OP_ASYNC_CANCEL
+	};
+	std::vector<char>			buffer(sizeof(struct io_uring_probe) + IORING_OP_LAST * sizeof(struct io_uring_probe_op), 0);
+	struct io_uring_probe		*probe = (struct io_uring_probe *)&buffer[0];
+
+	if (syscall(__NR_io_uring_register, _ringfd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) == -1)
+		return (false);
+	for (size_t i = 0; i < sizeof(required); ++i) {
+		if (required[i] > probe->last_op || !(probe->ops[required[i]].flags & IO_URING_OP_SUPPORTED))
+			return (false);
+	}
+	return (true);
+}
+
+/*
+Closes the ring first so the kernel drops every
+pending request before the buffers are freed.
+*/
+void	UringReactor::release()
+{
+	if (_ringfd != -1)
+		close(_ringfd);
+	_ringfd = -1;
+	if (_sqes != MAP_FAILED)
+		munmap(_sqes, _sqesSize);
+	if (_cqRing != MAP_FAILED && _cqRing != _sqRing)
+		munmap(_cqRing, _cqRingSize);
+	if (_sqRing != MAP_FAILED)
+		munmap(_sqRing, _sqRingSize);
+	_sqes = (struct io_uring_sqe *)MAP_FAILED;
+	_sqRing = _cqRing = MAP_FAILED;
+
+	for (size_t fd = 0; fd < _connections.size(); ++fd) {
+		if (_connections[fd]) {
+			close(fd);
+			delete _connections[fd];
+		}
+	}
+	_connections.clear();
+
+	delete [] _buffers;
+	_buffers = NULL;
+}
+
+/******************************************************************************/
+/*								RING MANAGEMENT								  */
+/******************************************************************************/
+
+/*
+Returns a cleared submission entry tagged with the operation
+and the socket it works on, or NULL if the queue stays full.
+The entry is published right away, the kernel only reads it
+at the next io_uring_enter.
+*/
+struct io_uring_sqe	*UringReactor::getSqe(Operation op, int fd)
+{
+	struct io_uring_sqe	*sqe;
+	unsigned			tail = *_sqTail;
+	unsigned			index;
+
+	if (tail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE) >= _sqEntries) {
+		submit(0);
+		if (tail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE) >= _sqEntries)
+			return (NULL);
+	}
+
+	index = tail & _sqMask;
+	sqe = &_sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->fd = fd;
+	sqe->user_data = ((uint64_t)op << 32) | (uint32_t)fd;
+	_sqArray[index] = index;
+	__atomic_store_n(_sqTail, tail + 1, __ATOMIC_RELEASE);
+	++_toSubmit;
+	return (sqe);
+}
+
+/*
+Hands the queued entries to the kernel,
+waiting for waitCount completions.
+*/
+int	UringReactor::submit(unsigned waitCount)
+{
+	int	ret;
+
+	ret = syscall(__NR_io_uring_enter, _ringfd, _toSubmit, waitCount, waitCount ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+	if (ret == -1)
+		return (-1);
+	_toSubmit -= ret;
+	return (ret);
+}
+
+/******************************************************************************/
+/*						       EVENTS MANAGEMENT     						  */
+/******************************************************************************/
+
+/* Provides the receive buffers and arms the multishot accept */
+void	UringReactor::start(int socketServer)
+{
+	_socketServer = socketServer;
+	provideBuffers(0, URING_BUFFERS);
+	armAccept();
+}
+
+/*
+Submits what the previous batch queued, waits for at least one
+completion, then handles every completion available.
+An interrupted wait is not an error, the caller checks g_end.
+*/
+int	UringReactor::poll()
+{
+	unsigned	head;
+
+	if (submit(1) == -1)
+		return ((errno == EINTR) ? 0 : -1);
+	woke();
+
+	head = *_cqHead;
+	while (head != __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE)) {
+		struct io_uring_cqe	cqe = _cqes[head & _cqMask];
+
+		__atomic_store_n(_cqHead, ++head, __ATOMIC_RELEASE);
+		handleCompletion(cqe);
+	}
+	return (0);
+}
+
+/* Dispatches a completion to its handler according to its operation */
+void	UringReactor::handleCompletion(struct io_uring_cqe const &cqe)
+{
+	Operation	op = (Operation)(cqe.user_data >> 32);
+	int			fd = (int)(cqe.user_data & 0xffffffff);
+
+	if (op == OP_ACCEPT)
+		handleAccept(cqe);
+	else if (op == OP_RECV)
+		handleRecv(fd, cqe);
+	else if (op == OP_SEND)
+		handleSend(fd, cqe);
+	else if (op == OP_CANCEL)
+		handleCancel(fd, cqe);
+	else if (op == OP_PROVIDE && cqe.res < 0)
+		LOG_ERROR << "cannot provide buffers: " << strerror(-cqe.res);
+}
+
+/*
+Creates the user of an accepted socket, re-arming accept when the kernel
+stopped it, as a one-shot accept when it rejected the multishot one.
+Out of file descriptors, the kernel fails an accept before looking for
+a connection: the pending one is refused, or accept waits for a socket
+to be closed when there was none.
+*/
+void	UringReactor::handleAccept(struct io_uring_cqe const &cqe)
+{
+	if (cqe.res == -EINVAL && _multishotAccept) {
+		LOG_WARN << "io_uring: no multishot accept, accepting one connection at a time";
+		_multishotAccept = false;
+	} else if ((cqe.res == -EMFILE || cqe.res == -ENFILE) && !_reserve.shed(_socketServer)) {
+		_acceptPaused = true;
+		return ;
+	} else if (cqe.res >= 0) {
+		sockaddr_in	addr;
+		socklen_t	size = sizeof(addr);
+
+		memset(&addr, 0, sizeof(addr));
+		getpeername(cqe.res, (struct sockaddr *)&addr, &size);
+		_server.createUser(cqe.res, addr);
+	}
+
+	if (!(cqe.flags & IORING_CQE_F_MORE))
+		armAccept();
+}
+
+/*
+Copies received bytes into the user's buffer, gives the
+provided buffer back to the kernel and hands the input to the server.
+When the provided buffers ran out, the socket reads once into its own
+buffer before going back to the multishot recv.
+*/
+void	UringReactor::handleRecv(int fd, struct io_uring_cqe const &cqe)
+{
+	Connection	*conn = _connections[fd];
+	bool		more = (cqe.flags & IORING_CQE_F_MORE);
+	User		*user = conn->user;
+
+	if (!more)
+		conn->recvArmed = false;
+
+	if (user && user->isClosing())
+		user = NULL;
+
+	if (cqe.res == -EINVAL && _multishotRecv && !(cqe.flags & IORING_CQE_F_BUFFER)) {
+		LOG_WARN << "io_uring: no multishot recv, receiving one buffer at a time";
+		_multishotRecv = false;
+		if (user)
+			armRecv(fd);
+		else
+			closeIfIdle(fd);
+		return ;
+	}
+
+	if (cqe.flags & IORING_CQE_F_BUFFER) {
+		unsigned short	bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+
+		if (user && cqe.res > 0)
+			user->appendBuffer(_buffers + bid * BUFFER_SIZE, cqe.res);
+		provideBuffers(bid, 1);
+	} else if (user && cqe.res > 0)
+		user->appendBuffer(&conn->buffer[0], cqe.res);
+
+	if (!user) {
+		closeIfIdle(fd);
+		return ;
+	}
+
+	if (cqe.res > 0 || cqe.res == -ENOBUFS) {
+		if (cqe.res > 0)
+			_server.handleInput(*user, false);
+		if (!more && !user->isClosing() && cqe.res == -ENOBUFS)
+			armRecvOnce(fd);
+		else if (!more && !user->isClosing())
+			armRecv(fd);
+		return ;
+	}
+
+	_server.handleInput(*user, true);
+}
+
+/*
+Consumes the sent bytes from the user's queue, then sends the rest,
+a short send simply resuming from where it stopped. A cancelled or
+interrupted send is retried, other errors mean the socket is dead.
+*/
+void	UringReactor::handleSend(int fd, struct io_uring_cqe const &cqe)
+{
+	Connection	*conn = _connections[fd];
+
+	conn->sendInflight = false;
+	if (conn->user && cqe.res > 0)
+		conn->user->consumeOutput(cqe.res);
+	else if (cqe.res < 0 && cqe.res != -ECANCELED && cqe.res != -EINTR && cqe.res != -EAGAIN)
+		conn->sendFailed = true;
+
+	if (!conn->user) {
+		closeIfIdle(fd);
+		return ;
+	}
+
+	if (conn->sendFailed)
+		_server.removeUser(*conn->user, "Connection closed");
+	else if (conn->user->hasPendingOutput())
+		flush(*conn->user);
+}
+
+/* Queues the accept, multishot when supported, new sockets come back non-blocking */
+void	UringReactor::armAccept()
+{
+	struct io_uring_sqe	*sqe = getSqe(OP_ACCEPT, _socketServer);
+
+	if (!sqe)
+		return ;
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->ioprio = _multishotAccept ? IORING_ACCEPT_MULTISHOT : 0;
+	sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+}
+
+/* Queues the recv of a socket, multishot when supported, picking buffers from the provided group */
+void	UringReactor::armRecv(int fd)
+{
+	struct io_uring_sqe	*sqe = getSqe(OP_RECV, fd);
+
+	if (!sqe)
+		return ;
+	sqe->opcode = IORING_OP_RECV;
+	sqe->ioprio = _multishotRecv ? IORING_RECV_MULTISHOT : 0;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = URING_BUFFER_GROUP;
+	_connections[fd]->recvArmed = true;
+}
+
+/* Queues a single recv of a socket into its own buffer, allocated on first use */
+void	UringReactor::armRecvOnce(int fd)
+{
+	struct io_uring_sqe	*sqe = getSqe(OP_RECV, fd);
+
+	if (!sqe)
+		return ;
+	_connections[fd]->buffer.resize(BUFFER_SIZE);
+	sqe->opcode = IORING_OP_RECV;
+	sqe->addr = (uint64_t)(uintptr_t)&_connections[fd]->buffer[0];
+	sqe->len = BUFFER_SIZE;
+	_connections[fd]->recvArmed = true;
+}
+
+/* Gives count receive buffers starting at bid to the kernel */
+void	UringReactor::provideBuffers(unsigned short bid, unsigned count)
+{
+	struct io_uring_sqe	*sqe = getSqe(OP_PROVIDE, count);
+
+	if (!sqe)
+		return ;
+	sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+	sqe->addr = (uint64_t)(uintptr_t)(_buffers + bid * BUFFER_SIZE);
+	sqe->len = BUFFER_SIZE;
+	sqe->off = bid;
+	sqe->buf_group = URING_BUFFER_GROUP;
+}
+
+/******************************************************************************/
+/*							CONNECTIONS MANAGEMENT							  */
+/******************************************************************************/
+
+/*
+Starts receiving on the socket of a new user
+- Success: returns 0
+- Error: returns 1.
+*/
+int	UringReactor::addConnection(User &user)
+{
+	int	fd = user.getSocket();
+
+	if ((size_t)fd >= _connections.size())
+		_connections.resize(fd + 1, NULL);
+	if (_connections[fd])
+		return (1);
+
+	_connections[fd] = new Connection();
+	_connections[fd]->user = &user;
+	armRecv(fd);
+	if (!_connections[fd]->recvArmed) {
+		delete _connections[fd];
+		_connections[fd] = NULL;
+		return (1);
+	}
+	return (0);
+}
+
+/*
+Submits what is left in the user's queue, then cancels every request
+on the socket: sends which can't complete right away are dropped.
+The queue is kept alive until the kernel is done with it and
+the socket is closed once its last request completed.
+*/
+void	UringReactor::removeConnection(User &user)
+{
+	int					fd = user.getSocket();
+	Connection			*conn = _connections[fd];
+
+	flush(user);
+	user.releaseSendQueue(conn->orphanQueue);
+	conn->user = NULL;
+
+	cancelRequests(fd);
+	closeIfIdle(fd);
+}
+
+/*
+Cancels the requests in flight on a socket: all at once by socket,
+or one by one, a recv and a send at most, where that is rejected.
+*/
+void	UringReactor::cancelRequests(int fd)
+{
+	Connection			*conn = _connections[fd];
+	struct io_uring_sqe	*sqe;
+
+	if (_cancelByFd && (conn->recvArmed || conn->sendInflight)) {
+		sqe = getSqe(OP_CANCEL, fd);
+		if (sqe) {
+			sqe->opcode = IORING_OP_ASYNC_CANCEL;
+			sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+		}
+		return ;
+	}
+	if (conn->recvArmed)
+		cancelRequest(fd, OP_RECV);
+	if (conn->sendInflight)
+		cancelRequest(fd, OP_SEND);
+}
+
+/* Cancels the request of an operation on a socket by its user data */
+void	UringReactor::cancelRequest(int fd, Operation op)
+{
+	struct io_uring_sqe	*sqe = getSqe(OP_CANCEL, fd);
+
+	if (!sqe)
+		return ;
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = ((uint64_t)op << 32) | (uint32_t)fd;
+}
+
+/*
+Falls back to cancelling request by request when cancelling by socket
+is rejected, for the socket still waiting on its requests.
+*/
+void	UringReactor::handleCancel(int fd, struct io_uring_cqe const &cqe)
+{
+	Connection	*conn;
+
+	if (cqe.res != -EINVAL || !_cancelByFd)
+		return ;
+	LOG_WARN << "io_uring: no cancelling by socket, cancelling each request";
+	_cancelByFd = false;
+	conn = ((size_t)fd < _connections.size()) ? _connections[fd] : NULL;
+	if (conn && !conn->user)
+		cancelRequests(fd);
+}
+
+/*
+Writes the outbound queue of a user with a single sendmsg gathering
+up to SEND_IOV_MAX queued messages, the iovecs living in the connection
+until the send completes. Only one send per socket is in flight so that
+bytes are never reordered, handleSend starts the next one
+- Success: returns 0
+- Error: returns 1.
+*/
+int	UringReactor::flush(User &user)
+{
+	Connection			*conn = _connections[user.getSocket()];
+	struct io_uring_sqe	*sqe;
+
+	if (conn->sendFailed)
+		return (1);
+	if (conn->sendInflight || !user.hasPendingOutput())
+		return (0);
+
+	sqe = getSqe(OP_SEND, user.getSocket());
+	if (!sqe)
+		return (0);
+	memset(&conn->msg, 0, sizeof(conn->msg));
+	conn->msg.msg_iov = conn->iov;
+	conn->msg.msg_iovlen = user.getSendQueue().gather(conn->iov, SEND_IOV_MAX);
+	sqe->opcode = IORING_OP_SENDMSG;
+	sqe->addr = (uint64_t)(uintptr_t)&conn->msg;
+	sqe->len = 1;
+	sqe->msg_flags = MSG_NOSIGNAL;
+	conn->sendInflight = true;
+	return (0);
+}
+
+/* Closes the socket once it was removed and no request uses it anymore, resuming a paused accept */
+void	UringReactor::closeIfIdle(int fd)
+{
+	Connection	*conn = _connections[fd];
+
+	if (conn->user || conn->recvArmed || conn->sendInflight)
+		return ;
+	close(fd);
+	delete conn;
+	_connections[fd] = NULL;
+	if (_acceptPaused) {
+		_acceptPaused = false;
+		armAccept();
+	}
+}
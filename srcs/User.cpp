@@ -13,10 +13,17 @@ with default values for its member variables.
 User::User(void) :
 	_username(""),
 	_nickname(""),
+	_socket(-1),
 	_inetNtoa(""),
 	_sender(""),
 	_isConnected(false),
-	_connectionSent(false)
+	_connectionSent(false),
+	_writeArmed(false),
+	_flushPending(false),
+	_closing(false),
+	_operator(false),
+	_floodTime(0),
+	_fanoutMark(0)
 {}
 
 /*
@@ -27,18 +34,30 @@ initializing the connection status to false by default.
 User::User(std::string const & username, std::string const & nickname) : 
 	_username(username),
 	_nickname(nickname),
+	_socket(-1),
 	_inetNtoa(""),
 	_sender(""),
 	_isConnected(false),
-	_connectionSent(false)
+	_connectionSent(false),
+	_writeArmed(false),
+	_flushPending(false),
+	_closing(false),
+	_operator(false),
+	_floodTime(0),
+	_fanoutMark(0)
 {}
 
 /*
-Destructor ensureing that the socket
-associated with a User object is properly
-closed when the object is destroyed.
+Destructor, the socket is closed by the
+reactor in Reactor::removeConnection.
 */
-User::~User(void) { close(_socket); }
+User::~User(void) {}
+
+/* Users live in slabs of USER_POOL_SLAB, recycled across connections */
+static ObjectPool	g_userPool(sizeof(User), USER_POOL_SLAB);
+
+void	*User::operator new(size_t size) { return (g_userPool.allocate(size)); }
+void	User::operator delete(void *ptr, size_t size) { g_userPool.release(ptr, size); }
 
 /******************************************************************************/
 /*							SETTERS,  GETTERS AND UPDATERS						  */
@@ -46,26 +65,32 @@ User::~User(void) { close(_socket); }
 
 void	User::setUsername(std::string const & username) { _username = username; }
 void	User::setNickname(std::string const & nickname) {  _nickname = nickname; updateSender();}
-void	User::setCommands(std::deque<std::string> const & commands) { _commands = commands; }
-void	User::setBuffer(std::string const & buffer) { _commandBuffer = buffer; }
+void	User::appendBuffer(const char *data, size_t length) { _input.append(data, length); }
 void	User::setAddr(sockaddr_in const & addr) { _addr = addr; }
 void	User::setSocket(int const & socket) { _socket = socket; }
 void	User::setInet(std::string const & inet) { _inetNtoa = inet; }
 void	User::setStatus(bool const & connected) { _isConnected = connected; }
 void	User::setSent(bool const & connectionSent) { _connectionSent = connectionSent; }
+void	User::setWriteArmed(bool const & armed) { _writeArmed = armed; }
+void	User::setFlushPending(bool const & pending) { _flushPending = pending; }
+void	User::setClosing(bool const & closing) { _closing = closing; }
+void	User::setOperator(bool const & op) { _operator = op; }
+void	User::setFloodTime(time_t const & floodTime) { _floodTime = floodTime; }
+void	User::setFanoutMark(unsigned long const & mark) { _fanoutMark = mark; }
 
 const std::string& 				User::getUsername() const { return (_username); }
 const std::string&				User::getNickname() const { return (_nickname); }
 const std::string&				User::getInet() const { return (_inetNtoa); }
 const int&						User::getSocket() const { return (_socket); }
 const struct sockaddr_in&		User::getAddr() const { return (_addr); }
-const std::string&				User::getBuffer() const { return (_commandBuffer); }
-const std::deque<std::string>&	User::getCommands() const { return (_commands); }
 const std::string&				User::getSender() const  {return (_sender); }
+const time_t&					User::getFloodTime() const { return (_floodTime); }
+const unsigned long&			User::getFanoutMark() const { return (_fanoutMark); }
+InputBuffer&					User::getInput() { return (_input); }
 const std::string				User::getChannelJoined() const {
 	std::string channelJoinedStr;
-	for (size_t i = 0; i < _channelsJoined.size(); ++i)	{
-		channelJoinedStr.append(_channelsJoined[i]->getName() + " ");
+	for (size_t i = 0; i < _memberships.size(); ++i)	{
+		channelJoinedStr.append(_memberships[i]->channel->getName() + " ");
 	}
 	return (channelJoinedStr);
 }
@@ -76,84 +101,109 @@ void	User::updateSender() {
 	_sender = ":" + _nickname + "!" + "~" + _username + "@" + adress;
 }
 
-/*
-Allows adding commands to the list 
-of commands associated with a User object.
-Each command added using this function is
-stored in the _commands vector for later processing.
-*/
-void	User::addCommand(std::string const & command) { _commands.push_back(command); }
-
 /******************************************************************************/
 /*									CONNECTIONS									*/
 /******************************************************************************/
 
-/*
-Accepts an incoming connection on a server socket,
-configures the socket of the new connection in non-blocking mode,
-updates the client information in a user object,
-returns the file descriptor of the new socket.
-If an error occurs at any step, the function returns 0.
-*/
-int	User::createUserSocket(int socketServer)
-{
-	int			socket;
-	sockaddr_in	addr;
-	socklen_t	size;
-
-	size = sizeof(addr);
-	socket = accept(socketServer, (struct sockaddr *)&addr, &size);
-	if (socket == -1)
-		return (0);
-
-	if (fcntl(socket, F_SETFL, O_NONBLOCK) == -1)
-		return (0);
-
-	setAddr(addr);
-	setSocket(socket);
-	setInet(inet_ntoa(addr.sin_addr));
-	return (socket);
-}
-
 void	User::quit(Server &server, std::string const & reason)
 {
-	Channel* channel;
-	for (size_t i = 0; i < _channelsJoined.size(); i++)
+	Channel*	channel;
+	std::string	mess = CMD_QUIT(_sender, reason);
+
+	server.sendMessageToNeighbours(*this, mess);
+	while (!_memberships.empty())
 	{
-		channel = _channelsJoined[i];
-		channel->quit(server, *this, reason);
+		channel = _memberships.back()->channel;
+		channel->removeUser(*this);
 		if (channel->isEmpty())
 			server.removeChannel(channel);
 	}
+
+	// the invitations are keyed by the user, which the next connection may reuse
+	for (size_t i = 0; i < _invitations.size(); ++i) {
+		channel = server.findChannel(_invitations[i]);
+		if (channel)
+			channel->removeUser(*this);
+	}
+	_invitations.clear();
 }
 
 const bool&						User::isConnected() const { return (_isConnected); }
 const bool&						User::isSent() const { return (_connectionSent); }
+const bool&						User::isWriteArmed() const { return (_writeArmed); }
+const bool&						User::isFlushPending() const { return (_flushPending); }
+const bool&						User::isClosing() const { return (_closing); }
+const bool&						User::isOperator() const { return (_operator); }
 
 /******************************************************************************/
-/*								CHANNEL MANAGEMENT							  */
+/*									OUTPUT QUEUE								*/
 /******************************************************************************/
 
-void	User::addChannel(Channel *channel)
-{	
-    std::vector<Channel*>::iterator it = std::find(_channelsJoined.begin(), _channelsJoined.end(), channel);
+/*
+Appends a message to the outbound queue of the user.
+Nothing is written on the socket here, see sendPending.
+*/
+void	User::queueMessage(SharedBuffer const & message) { _sendQueue.push(message); }
 
-	if (it == _channelsJoined.end()) {
-		_channelsJoined.push_back(channel);
-	}
+bool				User::hasPendingOutput() const { return (!_sendQueue.empty()); }
+const SendQueue&	User::getSendQueue() const { return (_sendQueue); }
+
+/* Drops bytes written on the socket from the front of the queue */
+void	User::consumeOutput(size_t bytes) { _sendQueue.consume(bytes); }
+
+/*
+Hands the queue over to the caller, who keeps the
+messages alive while asynchronous sends still read them.
+*/
+void	User::releaseSendQueue(SendQueue &queue)
+{
+	queue.swap(_sendQueue);
+	_sendQueue.clear();
+}
+
+/*
+Writes as much of the outbound queue as the socket accepts:
+- Success: returns 0 when the queue is empty,
+- Would block: returns 1, the remaining bytes stay queued,
+- Error: returns -1, the queue is dropped since the connection is dead.
+*/
+int	User::sendPending() { return (_sendQueue.send(_socket)); }
+
+/******************************************************************************/
+/*								CHANNEL MANAGEMENT							  */
+/******************************************************************************/
+
+/* Appends a membership record, which remembers its slot in the list */
+void	User::linkMembership(Membership *membership)
+{
+	membership->userSlot = _memberships.size();
+	_memberships.push_back(membership);
 }
 
-void	User::leaveChannel(Channel *channel)
+/* Removes a membership record in constant time, moving the last one into its slot */
+void	User::unlinkMembership(Membership *membership)
 {
+	size_t	pos = membership->userSlot;
 
-    std::vector<Channel*>::iterator it = std::find(_channelsJoined.begin(), _channelsJoined.end(), channel);
+	if (pos >= _memberships.size() || _memberships[pos] != membership)
+		return ;
+	if (pos != _memberships.size() - 1) {
+		_memberships[pos] = _memberships.back();
+		_memberships[pos]->userSlot = pos;
+	}
+	_memberships.pop_back();
+}
 
-    if (it == _channelsJoined.end()) {
-        return ; // ce cas devrait jamais se produire en vrai
-    } else {
-        _channelsJoined.erase(it);
-    }
+const std::vector<Membership *>&	User::getMemberships() const { return (_memberships); }
 
+/*
+Remembers a channel which invited the user, by name since the channel
+may be gone by the time the user quits
+*/
+void	User::addInvitation(std::string const &channelName)
+{
+	if (std::find(_invitations.begin(), _invitations.end(), channelName) == _invitations.end())
+		_invitations.push_back(channelName);
 }
 
 /******************************************************************************/
@@ -29,7 +29,7 @@ std::string	toString(int n) {
 }
 
 bool	isValidName(std::string const &name) {
-	if (name.length() > 12)
+	if (name.length() > NICKNAME_MAX)
 		return (false);
 
 	for (size_t i = 0; i < name.length(); ++i) {
@@ -40,4 +40,32 @@ bool	isValidName(std::string const &name) {
     }
 
 	return (true);
-}
\ No newline at end of file
+}
+
+/*
+Lowers a nickname with the RFC 1459 casemapping,
+where {}|~ are the lower case of []\^
+*/
+std::string	ircLower(std::string const &name) {
+	std::string	lower(name);
+
+	for (size_t i = 0; i < lower.length(); ++i) {
+		char c = lower[i];
+		if (c >= 'A' && c <= '^')
+			lower[i] = c + ('a' - 'A');
+	}
+	return (lower);
+}
+
+/*Checks if a target names a channel, by its '#' or '&' prefix*/
+bool	isChannelName(std::string const &name) {
+	return (!name.empty() && (name[0] == '#' || name[0] == '&'));
+}
+
+/*Reads the monotonic clock, in nanoseconds, for durations*/
+unsigned long	monotonicNanoseconds() {
+	struct timespec	now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec * 1000000000UL + now.tv_nsec);
+}
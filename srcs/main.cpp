@@ -12,15 +12,26 @@ void handleSignal(int signum)
 int main(int argc, char **argv)
 {	
 	try {
-		if (argc != 3)
-			throw std::runtime_error("usage ./ircserv <port> <password>");
+		Config	config;
+
+		if (argc < 3)
+			throw std::runtime_error(USAGE);
+		parseConfig(argc, argv, config);
+		Logger::start(config.logLevel, config.logFile);
+		if (!config.metricsSocket.empty())
+			MetricsExporter::start(config.metricsSocket);
+		if (!config.capture.empty())
+			Capture::start(config.capture);
 		signal(SIGINT, handleSignal);
-		Server server(argv[1], argv[2]);
+		Server server(argv[1], argv[2], config);
 		server.run();
 
 	} catch (std::exception const &e) {
 		std::cerr << e.what() << std::endl;
 	}
+	Capture::stop();
+	MetricsExporter::stop();
+	Logger::stop();
 
 	return (0);
 }
@@ -0,0 +1,276 @@
+#include <iostream>
+#include <string>
+#include <map>
+#include <cstdio>
+#include <unistd.h>
+
+#include "Server.hpp"
+#include "Capture.hpp"
+
+/*
+Command tests: the server runs the real handlers on a reactor
+without sockets, whose flush keeps what each user was sent,
+and every test checks the lines a command sends back.
+*/
+
+# define FD_ALICE 1000
+# define FD_BOB 1001
+
+bool	g_end;
+
+/* Reactor whose sockets are strings, one per socket */
+class RecordingReactor : public Reactor {
+
+public:
+	virtual void	start(int) {}
+	virtual int		poll() { return (0); }
+	virtual int		addConnection(User &) { return (0); }
+	virtual void	removeConnection(User &user) { flush(user); }
+
+	virtual int		flush(User &user)
+	{
+		std::deque<SharedBuffer> const	&chunks = user.getSendQueue().getChunks();
+		std::string						&out = sent[user.getSocket()];
+		size_t							offset = user.getSendQueue().getOffset();
+		size_t							bytes = 0;
+
+		for (size_t i = 0; i < chunks.size(); ++i) {
+			out.append(chunks[i].data() + offset, chunks[i].length() - offset);
+			bytes += chunks[i].length() - offset;
+			offset = 0;
+		}
+		user.consumeOutput(bytes);
+		return (0);
+	}
+
+	std::map<int, std::string>	sent;
+};
+
+struct Test {
+	Server				*server;
+	RecordingReactor	*reactor;
+	size_t				failures;
+};
+
+/* Runs a command line of the user on socket fd, forgetting what was sent before */
+static void	exec(Test &test, int fd, std::string const &line)
+{
+	test.reactor->sent.clear();
+	test.server->execCommand(*test.server->findUserBySocket(fd), line.data(), line.length());
+	test.server->flushPendingWrites();
+}
+
+/* Checks that the user on socket fd was sent a line ending as expected */
+static void	expect(Test &test, std::string const &line, int fd, std::string const &expected)
+{
+	std::string const	&sent = test.reactor->sent[fd];
+
+	if (sent.find(" " + expected + "\r\n") != std::string::npos)
+		return ;
+	++test.failures;
+	std::cout << "FAIL " << line << std::endl
+		<< "  expected: " << expected << std::endl
+		<< "  sent:     " << sent << std::endl;
+}
+
+/* Registers a user through the handlers */
+static void	connect(Test &test, int fd, std::string const &nick)
+{
+	struct sockaddr_in	addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	test.server->createUser(fd, addr);
+	exec(test, fd, "PASS test");
+	exec(test, fd, "NICK " + nick);
+	exec(test, fd, "USER " + nick + " 0 * :" + nick);
+}
+
+/******************************************************************************/
+/*									TESTS									  */
+/******************************************************************************/
+
+/* The text of a command is its parameter at the same position, trailing or middle */
+static void	testTrailing(Test &test)
+{
+	std::string	line;
+
+	exec(test, FD_ALICE, "JOIN #test");
+	exec(test, FD_BOB, "JOIN #test");
+
+	exec(test, FD_ALICE, line = "PRIVMSG bob :hello there");
+	expect(test, line, FD_BOB, "PRIVMSG bob :hello there");
+	exec(test, FD_ALICE, line = "PRIVMSG bob hello");
+	expect(test, line, FD_BOB, "PRIVMSG bob :hello");
+	exec(test, FD_ALICE, line = "PRIVMSG bob hello there");
+	expect(test, line, FD_BOB, "PRIVMSG bob :hello");
+	exec(test, FD_ALICE, line = "PRIVMSG #test hello");
+	expect(test, line, FD_BOB, "PRIVMSG #test :hello");
+
+	exec(test, FD_ALICE, line = "NOTICE bob :a notice");
+	expect(test, line, FD_BOB, "NOTICE bob :a notice");
+	exec(test, FD_ALICE, line = "NOTICE bob notice");
+	expect(test, line, FD_BOB, "NOTICE bob :notice");
+
+	exec(test, FD_ALICE, line = "TOPIC #test :a new topic");
+	expect(test, line, FD_BOB, "TOPIC #test :a new topic");
+	exec(test, FD_ALICE, line = "TOPIC #test newtopic");
+	expect(test, line, FD_BOB, "TOPIC #test :newtopic");
+
+	exec(test, FD_BOB, line = "PART #test bye");
+	expect(test, line, FD_ALICE, "PART #test :bye");
+	exec(test, FD_BOB, "JOIN #test");
+	exec(test, FD_ALICE, line = "KICK #test bob spam");
+	expect(test, line, FD_BOB, "KICK #test bob :spam");
+}
+
+/* MODE on something else than an existing channel answers ERR_NOSUCHCHAN */
+static void	testModeTarget(Test &test)
+{
+	std::string	line;
+
+	exec(test, FD_ALICE, line = "MODE &missing +i");
+	expect(test, line, FD_ALICE, "403 alice &missing :No such channel");
+	exec(test, FD_ALICE, line = "MODE bob +i");
+	expect(test, line, FD_ALICE, "403 alice bob :No such channel");
+}
+
+/* A connection reusing the slot of an invited user is not invited */
+static void	testInvitationReuse(Test &test)
+{
+	int const	fd = FD_BOB + 1;
+	User		*carol;
+	std::string	line;
+
+	exec(test, FD_ALICE, "JOIN #secret");
+	exec(test, FD_ALICE, "MODE #secret +i");
+	connect(test, fd, "carol");
+	carol = test.server->findUserBySocket(fd);
+	exec(test, FD_ALICE, "INVITE carol #secret");
+	test.server->removeUser(*carol, "Connection closed");
+	test.server->flushPendingWrites();
+
+	connect(test, fd, "dave");
+	if (test.server->findUserBySocket(fd) != carol)
+		std::cout << "note: the user slot was not reused" << std::endl;
+	exec(test, fd, line = "JOIN #secret");
+	expect(test, line, fd, "473 dave #secret :Cannot join channel, (+i)");
+}
+
+/* Every command of the table is found by its name, whatever its case */
+static void	testFindCommand(Test &test)
+{
+	Server::Command const	*command;
+
+	for (size_t i = 0; (command = Server::getCommand(i)); ++i) {
+		std::string	name = command->name;
+
+		if (Server::findCommand(Span(name.data(), name.data() + name.length())) != command) {
+			++test.failures;
+			std::cout << "FAIL findCommand " << name << std::endl;
+		}
+		for (size_t j = 0; j < name.length(); ++j)
+			name[j] = tolower(name[j]);
+		if (Server::findCommand(Span(name.data(), name.data() + name.length())) != command) {
+			++test.failures;
+			std::cout << "FAIL findCommand " << name << std::endl;
+		}
+	}
+	if (Server::findCommand(Span()) || Server::findCommand(Span("PRIV", "PRIV" + 4))) {
+		++test.failures;
+		std::cout << "FAIL findCommand of an unknown command" << std::endl;
+	}
+}
+
+/* A message to a channel the sender is not on answers ERR_CANNOTSENDTOCHAN */
+static void	testCannotSendToChannel(Test &test)
+{
+	std::string	line;
+
+	exec(test, FD_ALICE, "JOIN #closed");
+	exec(test, FD_BOB, line = "PRIVMSG #closed :hello");
+	expect(test, line, FD_BOB, "404 bob #closed :Cannot send to channel");
+	if (test.reactor->sent[FD_ALICE].find("hello") != std::string::npos) {
+		++test.failures;
+		std::cout << "FAIL " << line << std::endl << "  delivered to a member" << std::endl;
+	}
+	exec(test, FD_ALICE, "PART #closed");
+}
+
+/* JOIN ignores the parameters past the channels and keys */
+static void	testJoinSurplus(Test &test)
+{
+	std::string	line;
+
+	exec(test, FD_ALICE, line = "JOIN #extra key surplus");
+	expect(test, line, FD_ALICE, "JOIN :#extra");
+	exec(test, FD_ALICE, "PART #extra");
+}
+
+/* Writes a capture file of one record on the given socket */
+static std::string	writeCapture(uint32_t socket)
+{
+	char		path[] = "/tmp/ircserv-capture-XXXXXX";
+	char		header[CAPTURE_HEADER_LENGTH];
+	uint64_t	time = 0;
+	uint32_t	length = 0;
+	int			fd = mkstemp(path);
+
+	memcpy(header, &time, 8);
+	memcpy(header + 8, &socket, 4);
+	memcpy(header + 12, &length, 4);
+	header[16] = CAPTURE_OPEN;
+	if (fd != -1) {
+		write(fd, CAPTURE_MAGIC, CAPTURE_MAGIC_LENGTH);
+		write(fd, header, sizeof(header));
+		close(fd);
+	}
+	return (path);
+}
+
+/* A record whose socket is no file descriptor is a corruption */
+static void	testCorruptedCapture(Test &test)
+{
+	uint32_t const	sockets[] = { 0xFFFFFFFF, 0x7FFFFFFF, 5 };
+	bool const		valid[] = { false, false, true };
+	CaptureRecord	record;
+
+	for (size_t i = 0; i < sizeof(sockets) / sizeof(*sockets); ++i) {
+		std::string const	path = writeCapture(sockets[i]);
+		CaptureReader		reader(path);
+
+		if (reader.next(record) != valid[i]) {
+			++test.failures;
+			std::cout << "FAIL capture record on socket " << sockets[i] << std::endl
+				<< "  expected: " << (valid[i] ? "read" : "rejected") << std::endl;
+		}
+		unlink(path.c_str());
+	}
+}
+
+int	main()
+{
+	Config				config;
+	Server				server("0", "test", config);
+	RecordingReactor	*reactor = new RecordingReactor();
+	Test				test;
+
+	server.setReactor(reactor);
+	test.server = &server;
+	test.reactor = reactor;
+	test.failures = 0;
+	connect(test, FD_ALICE, "alice");
+	connect(test, FD_BOB, "bob");
+
+	testFindCommand(test);
+	testTrailing(test);
+	testModeTarget(test);
+	testInvitationReuse(test);
+	testJoinSurplus(test);
+	testCannotSendToChannel(test);
+	testCorruptedCapture(test);
+
+	std::cout << (test.failures ? "FAILED" : "OK") << std::endl;
+	return (test.failures != 0);
+}